@@ -0,0 +1,165 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "benchmark/benchmark.h"
+
+#include "network_opt_local.h"
+
+namespace network_opt {
+namespace {
+
+// The 12-resistor instances of Friedman's puzzles, and the networks that
+// the paper found for them (see network_opt_figures.cc).
+const Ratio* const FRIEDMAN_TARGETS[] = {&RATIO_E, &RATIO_PI, &RATIO_PHI, &RATIO_SQRT2};
+const char* const FRIEDMAN_NAMES[] = {"E", "PI", "PHI", "SQRT2"};
+const char* const FRIEDMAN_NETWORKS[] = {
+  "N()[N(11)[N()[N()[N(6)[N({0,5})]]]][N(2)[N(9)[N()[N()[N()[N(1)][N()[N(3)][N(8)[N()[N(4)][N({7,10})]]]]]]]]]]",
+  "N()[N(10)[N()[N()[N()[N(6)[N(4)[N({0,1})]]]]][N()[N()[N(11)[N()[N(2)][N({3,8})]]]]]][N(7)[N({5,9})]]]",
+  "N()[N(8)[N()[N()[N()[N(4)[N(0)][N()[N(1)][N({6,7})]]]]][N()[N()[N({5,10})]]]][N(11)[N(2)][N(9)]][N(3)]]",
+  "N()[N()[N()[N()[N()[N()[N(0)][N(9)[N(3)[N(11)[N({2,7})]]]]]]][N()[N()[N(10)[N(1)][N(5)]]]]][N(4)][N({6,8})]]",
+};
+
+Problem friedman(unsigned int n, int64_t idx) {
+  return Problem(INT_SERIES, n, *FRIEDMAN_TARGETS[idx], false);
+}
+
+void BM_EvaluateTotal(benchmark::State& state) {
+  Problem problem = friedman(12, state.range(0));
+  Node* network = Node::parse(FRIEDMAN_NETWORKS[state.range(0)]);
+  NetworkEvaluator evaluator;
+  for (auto _ : state) benchmark::DoNotOptimize(evaluator.evaluate_total(problem, network));
+  state.SetLabel(FRIEDMAN_NAMES[state.range(0)]);
+  delete network;
+}
+BENCHMARK(BM_EvaluateTotal)->DenseRange(0, 3);
+
+void BM_Bound(benchmark::State& state) {
+  Problem problem = friedman(12, 1);
+  Node* network = &N()[NT({1,2,3,4})][N()[NT(5)][NT({6,7,8})]][NT({9,10,11,12})];
+  Bounder bounder;
+  for (auto _ : state) benchmark::DoNotOptimize(bounder.bound(problem, network));
+  delete network;
+}
+BENCHMARK(BM_Bound);
+
+void BM_Tabulate(benchmark::State& state) {
+  Problem problem = friedman(12, 1);
+  Tabulator tabulator(state.range(0));
+  for (auto _ : state) tabulator.tabulate(problem);
+  state.counters["entries"] = tabulator.stats.entries;
+}
+BENCHMARK(BM_Tabulate)->DenseRange(2, 4)->Unit(benchmark::kMillisecond);
+
+void BM_BinarySearch(benchmark::State& state) {
+  Problem problem = friedman(12, 1);
+  Tabulator tabulator(4);
+  tabulator.tabulate(problem);
+  Node* network = &N()[N()[NT(1)][NT(2)][NT(3)]][N()[NT({4,5,6,7})][NT(8)][NT(9)][NT(10)][NT(11)][NT(12)]];
+  Expander expander(network);
+  Node* expandable = expander.expandable();
+  Values values = expandable->values; expandable->values.clear();
+  for (auto _ : state) benchmark::DoNotOptimize(tabulator.binary_search(problem, network, expandable, values));
+  expandable->values = values;
+  delete network;
+}
+BENCHMARK(BM_BinarySearch);
+
+void BM_LinearSearch(benchmark::State& state) {
+  Problem problem = friedman(12, 1);
+  Tabulator tabulator(4);
+  tabulator.tabulate(problem);
+  Node* network = &N()[NT({1,2,3,4})][NT({5,6,7,8})][NT(9)][NT(10)][NT(11)][NT(12)];
+  Expander expander(network);
+  Node* expandable_0 = expander.expandable();
+  Node* expandable_1 = expander.expandable();
+  Values values_0 = expandable_0->values; expandable_0->values.clear();
+  Values values_1 = expandable_1->values; expandable_1->values.clear();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(tabulator.linear_search(
+        problem, network, expandable_0, expandable_1, values_0, values_1));
+  }
+  expandable_0->values = values_0;
+  expandable_1->values = values_1;
+  delete network;
+}
+BENCHMARK(BM_LinearSearch);
+
+void BM_MultiSearch(benchmark::State& state) {
+  Problem problem = friedman(12, 1);
+  Tabulator tabulator(4);
+  tabulator.tabulate(problem);
+  Node* network = &N()[NT({1,2,3,4})][N()[NT({5,6,7,8})][N()[NT({9,10,11,12})]]];
+  Expander expander(network);
+  std::vector<Node*> expandables;
+  std::vector<Values> values;
+  for (Node* node; (node = expander.expandable()); ) {
+    expandables.push_back(node);
+    values.push_back(node->values);
+    node->values.clear();
+  }
+  Stats stats;
+  for (auto _ : state) {
+    stats = Stats();
+    benchmark::DoNotOptimize(tabulator.multi_search(problem, network, expandables, values, -1, &stats));
+  }
+  // Out of the 52^3 combinations of entries.
+  if (Stats::enabled) state.counters["evaluations"] = stats.evaluations;
+  for (unsigned int i = 0; i < expandables.size(); ++i) expandables[i]->values = values[i];
+  delete network;
+}
+BENCHMARK(BM_MultiSearch);
+
+// The exact search is run on 8-resistor versions of the Friedman instances
+// (the 12-resistor ones take hours), and on the example of the README.
+void BM_Solver(benchmark::State& state) {
+  Problem problem = (state.range(0) < 4) ? friedman(8, state.range(0))
+                                         : Problem(E12_SERIES, 8, Ratio(8), true);
+  Stats stats;
+  for (auto _ : state) {
+    Solver solver(Params(true, 4));
+    benchmark::DoNotOptimize(solver.solve(problem));
+    stats = solver.get_stats();
+  }
+  state.SetLabel((state.range(0) < 4) ? FRIEDMAN_NAMES[state.range(0)] : "E12 SQRT");
+  if (Stats::enabled) state.counters["nodes"] = stats.nodes;
+}
+BENCHMARK(BM_Solver)->DenseRange(0, 4)->Unit(benchmark::kMillisecond);
+
+// Local search never completes, so it is run for a second on each of the
+// 12-resistor instances and measured by its rate of restarts and the cost
+// it reaches relative to the network found by the paper.
+void BM_LocalSolver(benchmark::State& state) {
+  Problem problem = friedman(12, state.range(0));
+  Node* network = Node::parse(FRIEDMAN_NETWORKS[state.range(0)]);
+  Ratio friedman_cost = NetworkEvaluator().evaluate_cost(problem, network);
+  delete network;
+  Params params(true, 4);
+  params.time_limit = 1;
+  Stats stats;
+  double relative_cost = 0;
+  for (auto _ : state) {
+    LocalSolver solver(params, 2022, NULL);
+    Node* best = solver.solve(problem);
+    relative_cost = boost::rational_cast<double>(best->ratio / friedman_cost);
+    stats = solver.get_stats();
+  }
+  state.SetLabel(FRIEDMAN_NAMES[state.range(0)]);
+  state.counters["relative_cost"] = relative_cost;
+  if (Stats::enabled) state.counters["restarts"] = benchmark::Counter(stats.restarts, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_LocalSolver)->DenseRange(0, 3)->Iterations(1)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace network_opt
+
+BENCHMARK_MAIN();
@@ -12,50 +12,96 @@ limitations under the License.
 */
 
 #include "network_opt.h"
+#include "absl/strings/numbers.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
 
 #define WRITEOP(s, op, mathmode) { if (op == '+' && mathmode) s += "$+$"; else s += op; }
 
 namespace network_opt {
 
-Ratio RATIO_E     = Ratio(271828182845905,100000000000000);
-Ratio RATIO_PI    = Ratio(314159265358979,100000000000000);
-Ratio RATIO_PHI   = Ratio(161803398874989,100000000000000);
-Ratio RATIO_SQRT2 = Ratio(141421356237309,100000000000000);
-
-Ratio INT_SERIES[] = {Ratio( 1), Ratio( 2), Ratio( 3), Ratio( 4),
-                      Ratio( 5), Ratio( 6), Ratio( 7), Ratio( 8),
-                      Ratio( 9), Ratio(10), Ratio(11), Ratio(12)};
-Ratio ODD_SERIES[] = {Ratio( 1), Ratio( 3), Ratio( 5), Ratio( 7),
-                      Ratio( 9), Ratio(11), Ratio(13), Ratio(15),
-                      Ratio(17), Ratio(19), Ratio(21), Ratio(23)};
-Ratio EVEN_SERIES[] = {Ratio(2), Ratio( 4), Ratio( 6), Ratio( 8),
-                      Ratio(10), Ratio(12), Ratio(14), Ratio(16),
-                      Ratio(18), Ratio(20), Ratio(22), Ratio(24)};
-Ratio E12_SERIES[] = {Ratio(10,10), Ratio(12,10), Ratio(15,10), Ratio(18,10),
-                      Ratio(22,10), Ratio(27,10), Ratio(33,10), Ratio(39,10),
-                      Ratio(47,10), Ratio(56,10), Ratio(68,10), Ratio(82,10)};
-Ratio ONE_SERIES[] = {Ratio(1), Ratio(1), Ratio(1), Ratio(1),
-                      Ratio(1), Ratio(1), Ratio(1), Ratio(1),
-                      Ratio(1), Ratio(1), Ratio(1), Ratio(1),
-                      Ratio(1), Ratio(1), Ratio(1), Ratio(1)};
-
-Problem Problem::from_argv(char* argv[]) {
-  unsigned int n = atoi(argv[4]);
-  std::string s = argv[5], g = argv[6];
-  Ratio* series = E12_SERIES;
-  Ratio target = Ratio(n);
-  bool square = true;
-  if (s ==   "INT") series = INT_SERIES;
-  if (s ==   "ODD") series = ODD_SERIES;
-  if (s ==  "EVEN") series = EVEN_SERIES;
-  if (s ==   "ONE") series = ONE_SERIES;
-  if (g ==     "E") { square = false; target = RATIO_E; }
-  if (g ==    "PI") { square = false; target = RATIO_PI; }
-  if (g ==   "PHI") { square = false; target = RATIO_PHI; }
-  if (g == "SQRT2") { square = false; target = RATIO_SQRT2; }
+const Ratio RATIO_E     = Ratio(271828182845905,100000000000000);
+const Ratio RATIO_PI    = Ratio(314159265358979,100000000000000);
+const Ratio RATIO_PHI   = Ratio(161803398874989,100000000000000);
+const Ratio RATIO_SQRT2 = Ratio(141421356237309,100000000000000);
+
+const Ratio INT_SERIES[] = {Ratio( 1), Ratio( 2), Ratio( 3), Ratio( 4),
+                            Ratio( 5), Ratio( 6), Ratio( 7), Ratio( 8),
+                            Ratio( 9), Ratio(10), Ratio(11), Ratio(12)};
+const Ratio ODD_SERIES[] = {Ratio( 1), Ratio( 3), Ratio( 5), Ratio( 7),
+                            Ratio( 9), Ratio(11), Ratio(13), Ratio(15),
+                            Ratio(17), Ratio(19), Ratio(21), Ratio(23)};
+const Ratio EVEN_SERIES[] = {Ratio(2), Ratio( 4), Ratio( 6), Ratio( 8),
+                            Ratio(10), Ratio(12), Ratio(14), Ratio(16),
+                            Ratio(18), Ratio(20), Ratio(22), Ratio(24)};
+const Ratio E12_SERIES[] = {Ratio(10,10), Ratio(12,10), Ratio(15,10), Ratio(18,10),
+                            Ratio(22,10), Ratio(27,10), Ratio(33,10), Ratio(39,10),
+                            Ratio(47,10), Ratio(56,10), Ratio(68,10), Ratio(82,10)};
+const Ratio ONE_SERIES[] = {Ratio(1), Ratio(1), Ratio(1), Ratio(1),
+                            Ratio(1), Ratio(1), Ratio(1), Ratio(1),
+                            Ratio(1), Ratio(1), Ratio(1), Ratio(1),
+                            Ratio(1), Ratio(1), Ratio(1), Ratio(1)};
+
+// Sets series and size to the values of the named series, if there is one.
+static bool find_series(const std::string& s, const Ratio** series, unsigned int* size) {
+  *series = NULL;
+  if (s ==   "INT") { *series = INT_SERIES;  *size = std::size(INT_SERIES); }
+  if (s ==   "ODD") { *series = ODD_SERIES;  *size = std::size(ODD_SERIES); }
+  if (s ==  "EVEN") { *series = EVEN_SERIES; *size = std::size(EVEN_SERIES); }
+  if (s ==   "E12") { *series = E12_SERIES;  *size = std::size(E12_SERIES); }
+  if (s ==   "ONE") { *series = ONE_SERIES;  *size = std::size(ONE_SERIES); }
+  return *series;
+}
+
+// Parses a target, where SQRT stands for the square root of n.
+static absl::Status parse_target(const std::string& g, unsigned int n, Ratio* target, bool* square) {
+  *target = Ratio(n);
+  *square = true;
+  if (g ==     "E") { *square = false; *target = RATIO_E; }
+  if (g ==    "PI") { *square = false; *target = RATIO_PI; }
+  if (g ==   "PHI") { *square = false; *target = RATIO_PHI; }
+  if (g == "SQRT2") { *square = false; *target = RATIO_SQRT2; }
+  if (*square && g != "SQRT") {
+    if (!parse_ratio(g, target)) return absl::InvalidArgumentError("unknown target: " + g);
+    *square = false;
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<Problem> Problem::from_spec(const std::string& s, const std::string& n_str,
+                                           const std::string& g) {
+  const Ratio* series;
+  unsigned int size = 0, n = 0;
+  if (!find_series(s, &series, &size)) return absl::InvalidArgumentError("unknown series: " + s);
+  if (!absl::SimpleAtoi(n_str, &n) || n < 1 || n > size)
+    return absl::InvalidArgumentError("n must be in [1, " + std::to_string(size) + "] for " + s + ": " + n_str);
+  Ratio target;
+  bool square;
+  absl::Status status = parse_target(g, n, &target, &square);
+  if (!status.ok()) return status;
   return Problem(series, n, target, square);
 }
 
+absl::StatusOr<Problem> Problem::from_supply_spec(const std::string& s, const std::string& k_str,
+                                                  const std::string& g) {
+  const Ratio* series;
+  unsigned int size = 0, k = 0;
+  if (!find_series(s, &series, &size)) return absl::InvalidArgumentError("unknown series: " + s);
+  if (!absl::SimpleAtoi(k_str, &k) || k < 1 || k > 8 * sizeof(Mask))
+    return absl::InvalidArgumentError("k must be in [1, " + std::to_string(8 * sizeof(Mask)) + "]: " + k_str);
+  Ratio target;
+  bool square;
+  absl::Status status = parse_target(g, k, &target, &square);
+  if (!status.ok()) return status;
+  Problem problem(series, 0, target, square);
+  for (unsigned int i = 0; i < size; ++i)
+    if (std::find(problem.elements.begin(), problem.elements.end(), series[i]) == problem.elements.end())
+      problem.elements.push_back(series[i]);
+  problem.max_parts = k;
+  return problem;
+}
+
 Problem::Problem(const Ratio* series, unsigned int n, const Ratio& t, bool s) {
   for (unsigned int i = 0; i < n; i++) elements.push_back(series[i]);
   target = t;
@@ -67,7 +113,61 @@ unsigned int Problem::size() const { return elements.size(); }
 const Ratio& Problem::operator[](unsigned int idx) const { return elements[idx]; }
 
 Ratio Problem::get_cost(const Ratio& total) const {
-  return (square ? total * total : total) - target;
+  Ratio power = square ? total * total : total;
+  return (kind == CONDUCTANCE) ? target - 1 / power : power - target;
+}
+
+Ratio Problem::measure(const Ratio& total) const { return (kind == CONDUCTANCE) ? 1 / total : total; }
+
+char Problem::symbol(char op) const {
+  if (kind != CAPACITANCE) return op;
+  return (op == '+') ? '|' : '+';
+}
+
+std::vector<Mask> inventory_subsets(const Problem& problem) {
+  Mask full = (1 << problem.size()) - 1;
+  if (!problem.inventory) return std::vector<Mask>(1, full);
+  // Of equal elements, a subset takes a prefix.
+  std::vector<Mask> previous_equal(problem.size(), 0);
+  for (unsigned int j = 0; j < problem.size(); ++j)
+    for (unsigned int i = 0; i < j; ++i)
+      if (problem[i] == problem[j]) previous_equal[j] = 1 << i;
+  std::vector<std::pair<unsigned int, Mask>> subsets;
+  for (Mask mask = 1; mask <= full; ++mask) {
+    unsigned int parts = __builtin_popcount(mask);
+    if (problem.max_parts && parts > problem.max_parts) continue;
+    bool prefix = true;
+    for (unsigned int j = 0; j < problem.size(); ++j)
+      if ((mask >> j & 1) && previous_equal[j] && !(mask & previous_equal[j])) prefix = false;
+    if (prefix) subsets.emplace_back(parts, mask);
+  }
+  std::sort(subsets.begin(), subsets.end());
+  std::vector<Mask> masks;
+  for (auto [parts, mask] : subsets) masks.push_back(mask);
+  return masks;
+}
+
+Mask used_elements(const Node* network) {
+  Mask mask = 0;
+  for (auto value : network->values) mask |= 1 << value;
+  for (auto child : network->children) mask |= used_elements(child);
+  return mask;
+}
+
+void spread_values(Node* network) {
+  for (auto child : network->children) spread_values(child);
+  while (network->values.size() > (network->children.empty() ? 2u : 1u)) {
+    network->children.push_back(&N(network->values.back()));
+    network->values.pop_back();
+  }
+}
+
+bool parse_kind(const std::string& s, Problem::Kind* kind) {
+  if (s == "RESISTANCE") *kind = Problem::RESISTANCE;
+  else if (s == "CAPACITANCE") *kind = Problem::CAPACITANCE;
+  else if (s == "CONDUCTANCE") *kind = Problem::CONDUCTANCE;
+  else return false;
+  return true;
 }
 
 Node& Node::create() { return *(new Node()); }
@@ -112,15 +212,15 @@ std::string Node::to_string(const Problem& problem, bool mathmode, bool top, cha
   std::string s = "";
   if (!top && values.size() + children.size() > 1) s += "(";
   for (auto& child : children) {
-    if (child != *children.begin()) WRITEOP(s, op1, mathmode);
+    if (child != *children.begin()) WRITEOP(s, problem.symbol(op1), mathmode);
     bool subtop = top && values.size() == 0 && children.size() == 1;
     s += child->ratio ? child->to_string(problem, mathmode, subtop)
                       : child->to_string(problem, mathmode, subtop, op2, op1);
   }
-  if (!values.empty() && !children.empty()) WRITEOP(s, op1, mathmode);
-  for (auto& value : values) {
-    if (value != *values.begin()) WRITEOP(s, op1, mathmode);
-    auto v = boost::rational_cast<long long>(problem[value] * 10);
+  if (!values.empty() && !children.empty()) WRITEOP(s, problem.symbol(op1), mathmode);
+  for (auto value = values.begin(); value != values.end(); ++value) {
+    if (value != values.begin()) WRITEOP(s, problem.symbol(op1), mathmode);
+    auto v = boost::rational_cast<long long>(problem[*value] * 10);
     s += std::to_string(v / 10);
     if (v % 10) s += "." + std::to_string(v % 10);
   }
@@ -131,9 +231,9 @@ std::string Node::to_string(const Problem& problem, bool mathmode, bool top, cha
 std::string Node::to_network(char op1, char op2) const {
   std::string s = "N(";
   if (values.size() > 1) s += "{";
-  for (auto& value : values) {
-    if (value != *values.begin()) s += ",";
-    s += std::to_string(value);
+  for (auto value = values.begin(); value != values.end(); ++value) {
+    if (value != values.begin()) s += ",";
+    s += std::to_string(*value);
   }
   if (values.size() > 1) s += "}";
   s += ")";
@@ -147,7 +247,145 @@ std::string Node::to_network(char op1, char op2) const {
   return s;
 }
 
-Ratio NetworkEvaluator::evaluate_total(const Problem& problem, const Node* node, int bound, char op1, char op2) {
+Node* Node::parse(const std::string& network) {
+  size_t pos = 0;
+  Node* node = parse(network, pos);
+  if (node && pos != network.size()) { delete node; return NULL; }
+  return node;
+}
+
+Node* Node::parse(const std::string& network, size_t& pos) {
+  if (network.compare(pos, 2, "N(") != 0) return NULL;
+  Node* node = &N();
+  pos += 2;
+  bool braces = pos < network.size() && network[pos] == '{';
+  if (braces) ++pos;
+  while (pos < network.size() && isdigit(network[pos])) {
+    size_t end = network.find_first_not_of("0123456789", pos);
+    if (end == std::string::npos || end - pos > 5) break;
+    node->values.push_back(std::stoul(network.substr(pos, end - pos)));
+    pos = end;
+    if (braces && network[pos] == ',') ++pos;
+  }
+  if (braces && (pos >= network.size() || network[pos++] != '}')) { delete node; return NULL; }
+  if (pos >= network.size() || network[pos++] != ')') { delete node; return NULL; }
+  while (pos < network.size() && network[pos] == '[') {
+    Node* child = parse(network, ++pos);
+    if (!child) { delete node; return NULL; }
+    node->children.push_back(child);
+    if (pos >= network.size() || network[pos++] != ']') { delete node; return NULL; }
+  }
+  return node;
+}
+
+// Appends the terms that node (a composition by op) contributes to a
+// composition by parent_op: its own terms if the two operators agree, and
+// otherwise the single term that it forms.  The values of a node that is
+// still to be expanded (see Expander) form a single term, {a,b,...}.
+static void canonical_terms(const Problem& problem, const Node* network, const Node* node, char op,
+                            char parent_op, std::vector<std::string>& terms) {
+  if (node->values.size() + node->children.size() == 1 && op != parent_op) {
+    if (node->values.empty()) {
+      const Node* child = node->children.front();
+      canonical_terms(problem, network, child, child->ratio ? '+' : parent_op, parent_op, terms);
+    } else {
+      std::ostringstream os;
+      os << problem[node->values.front()];
+      terms.push_back(os.str());
+    }
+    return;
+  }
+  std::vector<std::string> own_terms;
+  std::vector<std::string>& target = (op == parent_op) ? terms : own_terms;
+  bool expandable = node->values.size() > 2 ||
+                    (node->values.size() > 1 && (!node->children.empty() || node == network));
+  std::vector<std::string> values;
+  for (auto value : node->values) {
+    std::ostringstream os;
+    os << problem[value];
+    values.push_back(os.str());
+  }
+  if (expandable) {
+    std::sort(values.begin(), values.end());
+    std::string s = "{";
+    for (auto& value : values) s += ((s.size() > 1) ? "," : "") + value;
+    target.push_back(s + "}");
+  } else {
+    target.insert(target.end(), values.begin(), values.end());
+  }
+  for (auto child : node->children)
+    canonical_terms(problem, network, child, child->ratio ? '+' : (op == '+') ? '|' : '+', op, target);
+  if (op == parent_op) return;
+  std::sort(own_terms.begin(), own_terms.end());
+  std::string s = "(";
+  for (auto& term : own_terms) s += ((s.size() > 1) ? std::string(1, op) : "") + term;
+  terms.push_back(s + ")");
+}
+
+std::string canonical_network(const Problem& problem, const Node* network) {
+  // A network whose root has a single child is a parallel composition, whose
+  // terms end up here unjoined.
+  std::vector<std::string> terms;
+  canonical_terms(problem, network, network, '+', '|', terms);
+  if (terms.size() == 1) return terms.front();
+  std::sort(terms.begin(), terms.end());
+  std::string s = "(";
+  for (auto& term : terms) s += ((s.size() > 1) ? "|" : "") + term;
+  return s + ")";
+}
+
+static uint64_t mix(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+const uint64_t SERIES_HASH = 1, PARALLEL_HASH = 2, UNEXPANDED_HASH = 3;
+
+// Mirrors canonical_terms(), adding the hashes of the terms to *sum, which
+// is independent of their order.
+static void canonical_hash_terms(const std::vector<uint64_t>& element_hashes, const Node* network,
+                                 const Node* node, char op, char parent_op, uint64_t* sum) {
+  if (node->values.size() + node->children.size() == 1 && op != parent_op) {
+    if (node->values.empty()) {
+      const Node* child = node->children.front();
+      canonical_hash_terms(element_hashes, network, child, child->ratio ? '+' : parent_op, parent_op, sum);
+    } else {
+      *sum += element_hashes[node->values.front()];
+    }
+    return;
+  }
+  uint64_t own_sum = 0;
+  uint64_t* target = (op == parent_op) ? sum : &own_sum;
+  bool expandable = node->values.size() > 2 ||
+                    (node->values.size() > 1 && (!node->children.empty() || node == network));
+  uint64_t values = 0;
+  for (auto value : node->values) values += element_hashes[value];
+  *target += expandable ? mix(values + UNEXPANDED_HASH) : values;
+  for (auto child : node->children)
+    canonical_hash_terms(element_hashes, network, child, child->ratio ? '+' : (op == '+') ? '|' : '+', op,
+                         target);
+  if (op != parent_op) *sum += mix(own_sum + ((op == '+') ? SERIES_HASH : PARALLEL_HASH));
+}
+
+uint64_t canonical_hash(const std::vector<uint64_t>& element_hashes, const Node* network) {
+  uint64_t sum = 0;
+  canonical_hash_terms(element_hashes, network, network, '+', '|', &sum);
+  return mix(sum + PARALLEL_HASH);
+}
+
+std::vector<uint64_t> element_hashes(const Problem& problem) {
+  std::vector<uint64_t> hashes;
+  for (Value i = 0; i < problem.size(); ++i) {
+    std::ostringstream os;
+    os << problem[i];
+    hashes.push_back(mix(std::hash<std::string>()(os.str())));
+  }
+  return hashes;
+}
+
+Ratio NetworkEvaluator::evaluate_total(const Problem& problem, const Node* node, int bound, char op1, char op2) const {
   char op = (bound == 1) ? '+' : '|';
   Ratio result;
   if (!node->values.empty()) {
@@ -166,17 +404,107 @@ Ratio NetworkEvaluator::evaluate_total(const Problem& problem, const Node* node,
   return (op1 == '+') ? result : 1 / result;
 }
 
-Ratio NetworkEvaluator::evaluate_cost(const Problem& problem, const Node* node, int bound) {
+Ratio HoleFunction::operator()(const Ratio& x, const Ratio& y) const {
+  // Both polynomials are multiplied by the denominators of x and y.
+  const cpp_int scales[4] = {x.denominator() * y.denominator(), x.numerator() * y.denominator(),
+                             x.denominator() * y.numerator(), x.numerator() * y.numerator()};
+  cpp_int n = 0, d = 0;
+  for (unsigned int i = 0; i < 4; ++i) {
+    if (numerator[i]) n += numerator[i] * scales[i];
+    if (denominator[i]) d += denominator[i] * scales[i];
+  }
+  return Ratio(n, d);
+}
+
+// A HoleFunction whose coefficients are still ratios.
+struct RatioHoleFunction { Ratio numerator[4], denominator[4]; };
+
+static bool contains_hole(const Node* node, const Node* hole_x, const Node* hole_y) {
+  if (node == hole_x || node == hole_y) return true;
+  if (node->ratio) return false;
+  for (auto child : node->children) if (contains_hole(child, hole_x, hole_y)) return true;
+  return false;
+}
+
+// Multiplies polynomials of disjoint holes, so that no square terms arise.
+static void multiply(const Ratio (&p)[4], const Ratio (&q)[4], Ratio (&product)[4]) {
+  for (unsigned int i = 0; i < 4; ++i) product[i] = 0;
+  for (unsigned int i = 0; i < 4; ++i) {
+    if (!p[i]) continue;
+    for (unsigned int j = 0; j < 4; ++j) {
+      if (!q[j]) continue;
+      assert(!(i & j));
+      product[i | j] += p[i] * q[j];
+    }
+  }
+}
+
+static RatioHoleFunction evaluate_holes(const NetworkEvaluator& evaluator, const Problem& problem, const Node* node,
+                                        const Node* hole_x, const Node* hole_y, char op1, char op2) {
+  // As in evaluate_total(), terms accumulate as totals in series and as
+  // their reciprocals in parallel.  Subtrees without holes are constants.
+  Ratio sum = 0;
+  if (!node->values.empty()) {
+    char valueop = (node->values.size() > 2 || !node->children.empty()) ? '|' : op1;
+    Ratio subresult;
+    for (auto value : node->values) subresult += (valueop == '+') ? problem[value] : 1 / problem[value];
+    Ratio total = (valueop == '+') ? subresult : 1 / subresult;
+    sum += (op1 == '+') ? total : 1 / total;
+  }
+  RatioHoleFunction f;
+  f.denominator[0] = 1;
+  for (auto& child : node->children) {
+    if (!contains_hole(child, hole_x, hole_y)) {
+      Ratio total = child->ratio ? child->ratio : evaluator.evaluate_total(problem, child, 0, op2, op1);
+      sum += (op1 == '+') ? total : 1 / total;
+      continue;
+    }
+    RatioHoleFunction g;
+    if (child == hole_x || child == hole_y) {
+      g.numerator[(child == hole_x) ? 1 : 2] = 1;
+      g.denominator[0] = 1;
+    } else {
+      g = evaluate_holes(evaluator, problem, child, hole_x, hole_y, op2, op1);
+    }
+    if (op1 == '|') std::swap(g.numerator, g.denominator);
+    // f + g = (f.n g.d + g.n f.d) / (f.d g.d)
+    Ratio a[4], b[4];
+    multiply(f.numerator, g.denominator, a);
+    multiply(g.numerator, f.denominator, b);
+    for (unsigned int i = 0; i < 4; ++i) f.numerator[i] = a[i] + b[i];
+    multiply(f.denominator, g.denominator, a);
+    for (unsigned int i = 0; i < 4; ++i) f.denominator[i] = a[i];
+  }
+  if (sum) for (unsigned int i = 0; i < 4; ++i) f.numerator[i] += sum * f.denominator[i];
+  if (op1 == '|') std::swap(f.numerator, f.denominator);
+  return f;
+}
+
+HoleFunction NetworkEvaluator::evaluate_holes(const Problem& problem, const Node* node, const Node* hole_x,
+                                              const Node* hole_y, char op1, char op2) const {
+  RatioHoleFunction f = network_opt::evaluate_holes(*this, problem, node, hole_x, hole_y, op1, op2);
+  cpp_int scale = 1;
+  for (unsigned int i = 0; i < 4; ++i) {
+    scale = boost::multiprecision::lcm(scale, f.numerator[i].denominator());
+    scale = boost::multiprecision::lcm(scale, f.denominator[i].denominator());
+  }
+  HoleFunction g;
+  for (unsigned int i = 0; i < 4; ++i) {
+    g.numerator[i] = f.numerator[i].numerator() * (scale / f.numerator[i].denominator());
+    g.denominator[i] = f.denominator[i].numerator() * (scale / f.denominator[i].denominator());
+  }
+  return g;
+}
+
+Ratio NetworkEvaluator::evaluate_cost(const Problem& problem, const Node* node, int bound) const {
   Ratio total = evaluate_total(problem, node, bound);
   Ratio cost = problem.get_cost(total);
   return (cost > 0) ? cost : -cost;
 }
 
-NetworkEvaluator network_evaluator;
-
 Ratio Bounder::bound(const Problem& problem, const Node* network) {
-  Ratio lower_bound = network_evaluator.evaluate_total(problem, network, -1);
-  Ratio upper_bound = network_evaluator.evaluate_total(problem, network,  1);
+  Ratio lower_bound = evaluator.evaluate_total(problem, network, -1);
+  Ratio upper_bound = evaluator.evaluate_total(problem, network,  1);
   return max( problem.get_cost(lower_bound),
              -problem.get_cost(upper_bound));
 }
@@ -192,7 +520,7 @@ Node* Expander::expandable() {
   return NULL;
 }
 
-void SubsetCoder::decode(Mask mask, const Values& values, Values& include, Values& exclude) {
+void SubsetCoder::decode(Mask mask, const Values& values, Values& include, Values& exclude) const {
   for (auto value : values) {
     if (include.empty()) { include.push_back(value); continue; }
     if (mask & 0x1) include.push_back(value);
@@ -201,66 +529,290 @@ void SubsetCoder::decode(Mask mask, const Values& values, Values& include, Value
   }
 }
 
-Mask SubsetCoder::encode(const Values& values) {
+Mask SubsetCoder::encode(const Values& values) const {
   Mask mask = 0;
   for (auto value : values) mask |= 1 << value;
   return mask;
 }
 
-SubsetCoder coder;
+// Calls visit with every completion of network and its total, until visit
+// returns false; returns whether every completion was visited.
+template <typename Visit>
+static bool enumerate_completions(const Problem& problem, Node* network, const NetworkEvaluator& evaluator,
+                                  const SubsetCoder& coder, const Visit& visit) {
+  Expander expander(network);
+  Node* expandable = expander.expandable();
+  if (!expandable) return visit(network, evaluator.evaluate_total(problem, network));
+  Values values = expandable->values; expandable->values.clear();
+  bool has_children = !expandable->children.empty();
+  Node* child = &N();
+  expandable->children.push_back(child);
+  Mask max_mask = 1 << (values.size() - 1);
+  bool complete = true;
+  for (Mask mask = 0; complete && mask < max_mask; ++mask) {
+    coder.decode(mask, values, child->values, expandable->values);
+    if (has_children || !expandable->values.empty() || expandable == network)
+      complete = enumerate_completions(problem, network, evaluator, coder, visit);
+    child->values.clear();
+    expandable->values.clear();
+  }
+  expandable->children.pop_back();
+  delete child;
+  expandable->values = values;
+  return complete;
+}
+
+bool enumerate_networks(const Problem& problem, Mask mask, const NetworkVisitor& visit) {
+  Node* network = &N();
+  for (Value i = 0; i < problem.size(); ++i)
+    if (mask & (1 << i)) network->values.push_back(i);
+  bool complete = !mask || enumerate_completions(problem, network, NetworkEvaluator(), SubsetCoder(), visit);
+  delete network;
+  return complete;
+}
 
 void Tabulator::tabulate(const Problem& problem) {
   clear();
+  stats = Stats();
+  STAT(auto start = std::chrono::steady_clock::now());
   lookup_table.resize(1 << problem.size());
   Node* network = &N();
   tabulate(problem, network);
   delete network;
+  STAT(stats.tabulate_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
 }
 
-Node* Tabulator::binary_search(const Problem& problem, const Node* network, Node* expandable, const Values& values) {
+Node* Tabulator::binary_search(const Problem& problem, const Node* network, Node* expandable, const Values& values,
+                               Stats* stats) const {
   Mask mask = coder.encode(values);
-  std::vector<std::pair<Ratio, Node*>>& entry = lookup_table[mask];
+  const std::vector<std::pair<Ratio, Node*>>& entry = lookup_table[mask];
   int lo = 0, hi = entry.size(), best_idx = -1;
   Ratio best_cost = -1;
+  if (entry.empty()) return NULL;
+  expandable->children.push_back(entry[0].second);
+  HoleFunction total_of = evaluator.evaluate_holes(problem, network, entry[0].second, NULL);
+  expandable->children.pop_back();
   while (lo < hi) {
     int mid = (lo + hi) / 2;
-    expandable->children.push_back(entry[mid].second);
-    Ratio total = network_evaluator.evaluate_total(problem, network);
-    Ratio cost = problem.get_cost(total);
+    STAT(if (stats) { ++stats->probes; ++stats->evaluations; });
+    Ratio cost = problem.get_cost(total_of(entry[mid].first, 0));
     Ratio abs_cost = (cost > 0) ? cost : -cost;
     if (best_cost < 0 || best_cost > abs_cost) {
       best_cost = abs_cost; best_idx = mid;
     }
     if (cost < 0) lo = mid + 1; else hi = mid;
-    expandable->children.pop_back();
   }
   return entry[best_idx].second;
 }
 
 std::pair<Node*,Node*> Tabulator::linear_search(const Problem& problem, const Node* network, Node* expandable_0,
-    Node* expandable_1, const Values& values_0, const Values& values_1) {
+    Node* expandable_1, const Values& values_0, const Values& values_1, Stats* stats) const {
   Mask mask_0 = coder.encode(values_0), mask_1 = coder.encode(values_1);
-  std::vector<std::pair<Ratio, Node*>>& entry_0 = lookup_table[mask_0],
-                                        entry_1 = lookup_table[mask_1];
+  const std::vector<std::pair<Ratio, Node*>>& entry_0 = lookup_table[mask_0],
+                                            & entry_1 = lookup_table[mask_1];
   unsigned int lo = 0;
   int hi = entry_1.size() - 1, best_lo = -1, best_hi = -1;
   Ratio best_cost = -1;
+  if (entry_0.empty() || entry_1.empty()) return std::pair<Node*,Node*>(NULL, NULL);
+  expandable_0->children.push_back(entry_0[0].second);
+  expandable_1->children.push_back(entry_1[0].second);
+  HoleFunction total_of = evaluator.evaluate_holes(problem, network, entry_0[0].second, entry_1[0].second);
+  expandable_1->children.pop_back();
+  expandable_0->children.pop_back();
   while (lo < entry_0.size() && hi >= 0) {
-    expandable_0->children.push_back(entry_0[lo].second);
-    expandable_1->children.push_back(entry_1[hi].second);
-    Ratio total = network_evaluator.evaluate_total(problem, network);
-    Ratio cost = problem.get_cost(total);
+    STAT(if (stats) { ++stats->probes; ++stats->evaluations; });
+    Ratio cost = problem.get_cost(total_of(entry_0[lo].first, entry_1[hi].first));
     Ratio abs_cost = (cost > 0) ? cost : -cost;
     if (best_cost < 0 || best_cost > abs_cost) {
       best_cost = abs_cost; best_lo = lo; best_hi = hi;
     }
     if (cost < 0) lo += 1; else hi -= 1;
-    expandable_1->children.pop_back();
-    expandable_0->children.pop_back();
   }
   return std::pair<Node*,Node*>(entry_0[best_lo].second, entry_1[best_hi].second);
 }
 
+std::vector<Node*> Tabulator::multi_search(const Problem& problem, const Node* network,
+                                           const std::vector<Node*>& expandables, const std::vector<Values>& values,
+                                           const Ratio& cutoff, Stats* stats) const {
+  // The outer loops multiply, so they go over the shortest entries, leaving
+  // the longest two to the linear search.
+  std::vector<unsigned int> order(expandables.size());
+  for (unsigned int i = 0; i < order.size(); ++i) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&](unsigned int x, unsigned int y) {
+    return lookup_table[coder.encode(values[x])].size() < lookup_table[coder.encode(values[y])].size(); });
+  std::vector<Node*> ordered_expandables;
+  std::vector<Values> ordered_values;
+  for (auto i : order) {
+    ordered_expandables.push_back(expandables[i]);
+    ordered_values.push_back(values[i]);
+  }
+  std::vector<Node*> ordered_best;
+  Ratio best_cost = cutoff;
+  multi_search(problem, network, ordered_expandables, ordered_values, 0, ordered_best, best_cost, stats);
+  if (ordered_best.empty()) return ordered_best;
+  std::vector<Node*> best(expandables.size());
+  for (unsigned int i = 0; i < order.size(); ++i) best[order[i]] = ordered_best[i];
+  return best;
+}
+
+// Fills the expandables from depth on, given entries for those before it,
+// and keeps the best choice for all of them in best, if it costs less than
+// best_cost (or best_cost is negative).
+void Tabulator::multi_search(const Problem& problem, const Node* network, const std::vector<Node*>& expandables,
+                             const std::vector<Values>& values, unsigned int depth, std::vector<Node*>& best,
+                             Ratio& best_cost, Stats* stats) const {
+  unsigned int holes = expandables.size();
+  if (depth + 2 == holes) {
+    std::pair<Node*,Node*> nodes = linear_search(problem, network, expandables[depth], expandables[depth + 1],
+                                                 values[depth], values[depth + 1], stats);
+    expandables[depth]->children.push_back(nodes.first);
+    expandables[depth + 1]->children.push_back(nodes.second);
+    STAT(if (stats) ++stats->evaluations);
+    Ratio cost = problem.get_cost(evaluator.evaluate_total(problem, network));
+    if (cost < 0) cost = -cost;
+    if (best_cost < 0 || cost < best_cost) {
+      best_cost = cost;
+      best.clear();
+      for (auto expandable : expandables) best.push_back(expandable->children.back());
+    }
+    expandables[depth + 1]->children.pop_back();
+    expandables[depth]->children.pop_back();
+    return;
+  }
+  // The cost with the given entry here and every inner expandable at its
+  // first or last entry, which bounds the cost of every choice below.
+  const std::vector<std::pair<Ratio, Node*>>& entry = lookup_table[coder.encode(values[depth])];
+  auto extreme_cost = [&](unsigned int idx, bool last) {
+    expandables[depth]->children.push_back(entry[idx].second);
+    for (unsigned int i = depth + 1; i < holes; ++i) {
+      const std::vector<std::pair<Ratio, Node*>>& inner = lookup_table[coder.encode(values[i])];
+      expandables[i]->children.push_back(last ? inner.back().second : inner.front().second);
+    }
+    STAT(if (stats) { ++stats->probes; ++stats->evaluations; });
+    Ratio cost = problem.get_cost(evaluator.evaluate_total(problem, network));
+    for (unsigned int i = depth; i < holes; ++i) expandables[i]->children.pop_back();
+    return cost;
+  };
+  // Entries fall short of the target until the largest choice below reaches
+  // it, and overshoot once the smallest one does; both grow with the entry,
+  // so binary searches find the range worth trying.
+  unsigned int lo = 0, hi = entry.size();
+  if (best_cost >= 0) {
+    for (unsigned int end = hi; lo < end; ) {
+      unsigned int mid = (lo + end) / 2;
+      if (-extreme_cost(mid, true) >= best_cost) lo = mid + 1; else end = mid;
+    }
+  }
+  for (unsigned int idx = lo; idx < hi; ++idx) {
+    if (best_cost >= 0 && extreme_cost(idx, false) >= best_cost) break;
+    expandables[depth]->children.push_back(entry[idx].second);
+    multi_search(problem, network, expandables, values, depth + 1, best, best_cost, stats);
+    expandables[depth]->children.pop_back();
+  }
+}
+
+// A node of a std::list: two links and the element.
+static size_t list_node_bytes(size_t element_bytes) { return 2 * sizeof(void*) + std::max(element_bytes, sizeof(void*)); }
+
+size_t Tabulator::bytes() const {
+  size_t bytes = lookup_table.capacity() * sizeof(lookup_table[0]);
+  std::vector<const Node*> stack;
+  for (auto& entries : lookup_table) {
+    bytes += entries.capacity() * sizeof(entries[0]);
+    for (auto& entry : entries) stack.push_back(entry.second);
+  }
+  while (!stack.empty()) {
+    const Node* node = stack.back(); stack.pop_back();
+    bytes += sizeof(Node) + (node->values.size() + node->hidden.size()) * list_node_bytes(sizeof(Value)) +
+             node->children.size() * list_node_bytes(sizeof(Node*));
+    for (auto child : node->children) stack.push_back(child);
+  }
+  return bytes;
+}
+
+const char TABLE_MAGIC[] = "network_opt-table-1";
+
+// Tables only depend on the elements and m, and not on the target or kind.
+static std::string table_header(const Problem& problem, unsigned int m) {
+  std::ostringstream os;
+  os << TABLE_MAGIC << " m=" << m << " elements=";
+  for (auto& element : problem.elements) os << element << ",";
+  return os.str();
+}
+
+absl::Status Tabulator::save(const Problem& problem, const std::string& path) const {
+  std::string temporary = path + ".tmp";
+  std::ofstream file(temporary);
+  file << table_header(problem, m) << std::endl;
+  for (Mask mask = 0; mask < lookup_table.size(); ++mask)
+    for (auto& entry : lookup_table[mask]) file << mask << " " << entry.first << " " << entry.second->to_network() << "\n";
+  file.close();
+  if (!file || std::rename(temporary.c_str(), path.c_str()) != 0)
+    return absl::UnavailableError("cannot write " + path);
+  return absl::OkStatus();
+}
+
+absl::Status Tabulator::load(const Problem& problem, const std::string& path) {
+  std::ifstream file(path);
+  if (!file) return absl::NotFoundError("cannot read " + path);
+  std::string header;
+  std::getline(file, header);
+  if (header != table_header(problem, m))
+    return absl::InvalidArgumentError(path + " was saved for other elements or another m");
+  clear();
+  stats = Stats();
+  lookup_table.resize(1 << problem.size());
+  Mask mask;
+  std::string total, network;
+  while (file >> mask >> total >> network) {
+    Ratio ratio;
+    Node* node = (mask < lookup_table.size()) ? Node::parse(network) : NULL;
+    if (!node || !parse_ratio(total, &ratio) || !ratio) {
+      delete node;
+      clear();
+      return absl::InvalidArgumentError("corrupt table: " + path);
+    }
+    node->ratio = ratio;
+    lookup_table[mask].push_back(std::pair<Ratio, Node*>(ratio, node));
+    STAT(++stats.entries);
+  }
+  if (!file.eof()) {
+    clear();
+    return absl::InvalidArgumentError("corrupt table: " + path);
+  }
+  return absl::OkStatus();
+}
+
+// The number of series-parallel networks of k labeled elements (OEIS A006351).
+const unsigned long long NETWORKS[] = {0, 1, 2, 8, 52, 472, 5504, 78416, 1320064, 25637824, 564275648};
+const unsigned int MAX_TABLE_M = sizeof(NETWORKS) / sizeof(NETWORKS[0]) - 1;
+const double TABULATE_SECONDS_PER_ELEMENT = 3.5e-6;
+
+TableEstimate estimate_table(unsigned int n, unsigned int m) {
+  TableEstimate estimate;
+  estimate.bytes = double(1ull << n) * sizeof(std::vector<std::pair<Ratio, Node*>>);
+  double subsets = 1;  // n choose k
+  for (unsigned int k = 1; k <= std::min(m, n); ++k) {
+    subsets = subsets * (n - k + 1) / k;
+    double entries = subsets * NETWORKS[std::min(k, MAX_TABLE_M)];
+    estimate.entries += entries;
+    estimate.bytes += entries * (sizeof(std::pair<Ratio, Node*>) + k * sizeof(Node) +
+                                 k * list_node_bytes(sizeof(Value)) + (k - 1) * list_node_bytes(sizeof(Node*)));
+    estimate.seconds += entries * k * TABULATE_SECONDS_PER_ELEMENT;
+  }
+  return estimate;
+}
+
+unsigned int choose_m(unsigned int n, double max_bytes, double max_seconds) {
+  unsigned int m = 0;
+  while (m < std::min(n, MAX_TABLE_M)) {
+    TableEstimate estimate = estimate_table(n, m + 1);
+    if (estimate.bytes > max_bytes || (max_seconds > 0 && estimate.seconds > max_seconds)) break;
+    ++m;
+  }
+  return m;
+}
+
 void Tabulator::clear() {
   for (auto entries : lookup_table) for (auto entry : entries) delete entry.second;
   lookup_table.clear();
@@ -270,8 +822,15 @@ void Tabulator::tabulate(const Problem& problem, Node* network, Mask mask, Value
   if (i >= problem.size()) {
     if (mask) {
       std::vector<std::pair<Ratio, Node*>>& entry = lookup_table[mask];
-      tabulate(problem, network, entry);
-      sort(entry.begin(), entry.end());
+      enumerate_completions(problem, network, evaluator, coder, [&](Node* complete, const Ratio& total) {
+        STAT(++stats.entries; ++stats.evaluations);
+        Node* clone = complete->clone();
+        clone->ratio = total;
+        entry.push_back(std::pair<Ratio, Node*>(total, clone));
+        return true;
+      });
+      // Stable, so that the order (which checkpoints refer to) is reproducible.
+      std::stable_sort(entry.begin(), entry.end(), [](const auto& x, const auto& y) { return x.first < y.first; });
     }
     return;
   }
@@ -283,118 +842,408 @@ void Tabulator::tabulate(const Problem& problem, Node* network, Mask mask, Value
   }
 }
 
-void Tabulator::tabulate(const Problem& problem, Node* network, std::vector<std::pair<Ratio, Node*>>& entry) {
-  Expander expander(network);
-  Node* expandable = expander.expandable();
-  if (!expandable) {
-    Node* clone = network->clone();
-    clone->ratio = network_evaluator.evaluate_total(problem, network);
-    entry.push_back(std::pair<Ratio, Node*>(clone->ratio, clone));
-    return;
+
+Deadline::Deadline(double seconds, unsigned int _stride, const std::atomic<bool>* _cancel)
+    : limited(seconds > 0), passed(false), stride(_stride), calls(0), cancel(_cancel) {
+  end = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(seconds));
+}
+
+bool Deadline::expired() {
+  if ((limited || cancel) && !passed && ++calls % stride == 0) {
+    passed = (cancel && cancel->load(std::memory_order_relaxed)) ||
+             (limited && std::chrono::steady_clock::now() >= end);
   }
-  Values values = expandable->values; expandable->values.clear();
-  bool has_children = !expandable->children.empty();
-  Node* child = &N();
-  expandable->children.push_back(child);
-  Mask max_mask = 1 << (values.size() - 1);
-  for (Mask mask = 0; mask < max_mask; ++mask) {
-    coder.decode(mask, values, child->values, expandable->values);
-    if (has_children || !expandable->values.empty() || expandable == network)
-      tabulate(problem, network, entry);
-    child->values.clear();
-    expandable->values.clear();
+  return passed;
+}
+
+bool TopNetworks::offer(const Problem& problem, Node* network, const Ratio& cost) {
+  if (full() && cutoff() <= cost) return false;
+  std::string canonical = (k > 1) ? canonical_network(problem, network) : "";
+  if (k > 1 && std::find(canonicals.begin(), canonicals.end(), canonical) != canonicals.end()) return false;
+  // Among equal costs, the network offered first stays ahead.
+  unsigned int idx = 0;
+  while (idx < networks.size() && networks[idx]->ratio <= cost) ++idx;
+  Node* clone = network->clone();
+  clone->ratio = cost;
+  networks.insert(networks.begin() + idx, clone);
+  canonicals.insert(canonicals.begin() + idx, canonical);
+  if (networks.size() > k) {
+    delete networks.back();
+    networks.pop_back();
+    canonicals.pop_back();
   }
-  expandable->children.pop_back();
-  delete child;
-  expandable->values = values;
+  return true;
+}
+
+void TopNetworks::clear() {
+  for (auto network : networks) delete network;
+  networks.clear();
+  canonicals.clear();
+}
+
+bool TranspositionTable::visit(uint64_t hash) {
+  hash |= 1;  // Zero marks an empty slot.
+  uint64_t& slot = slots[hash & (slots.size() - 1)];
+  if (slot == hash) return true;
+  slot = hash;
+  return false;
 }
 
-Solver::Solver(const Params& params) : bounder(NULL), tabulator(NULL), best_network(NULL) {
+Solver::Solver(const Params& _params)
+    : params(_params), bounder(NULL), tabulator(NULL), table(NULL), top(_params.k),
+      stopped(false), trace(NULL), bounded(false), checkpoint_seconds(0), replaying(false),
+      transpositions(_params.transposition_bits) {
+  if (params.b) bounder = new Bounder();
+  if (params.m) table = tabulator = new Tabulator(params.m);
+}
+
+Solver::Solver(const Params& _params, const Tabulator* shared_tabulator)
+    : params(_params), bounder(NULL), tabulator(NULL), table(shared_tabulator), top(_params.k),
+      stopped(false), trace(NULL), bounded(false), checkpoint_seconds(0), replaying(false),
+      transpositions(_params.transposition_bits) {
   if (params.b) bounder = new Bounder();
-  if (params.m) tabulator = new Tabulator(params.m);
 }
 
 Solver::~Solver() {
-  clear();
+  for (auto seed_network : seed_networks) delete seed_network;
   if (tabulator) delete tabulator;
   if (bounder) delete bounder;
 }
 
 Node* Solver::solve(const Problem& problem) {
-  clear();
+  start = std::chrono::steady_clock::now();
+  deadline = Deadline(params.time_limit, 256, params.cancel);
+  stopped = bounded = false;
+  stats = Stats();
+  top.clear();
+  for (auto seed_network : seed_networks) {
+    offer(problem, seed_network, evaluator.evaluate_cost(problem, seed_network));
+    delete seed_network;
+  }
+  seed_networks.clear();
+  checkpoint_deadline = Deadline(checkpoint_seconds);
+  checkpoint_status = absl::OkStatus();
+  path.clear();
+  replaying = !replay.empty();
+  transpositions.clear();
+  if (transpositions.enabled() || params.k > 1) hashes = element_hashes(problem);
   Node* network = &N();
   for (Value i = 0; i < problem.size(); ++i) network->values.push_back(i);
   if (tabulator) tabulator->tabulate(problem);
-  solve(problem, network);
+  STAT(if (tabulator) stats = tabulator->stats);
+  STAT(auto search_start = std::chrono::steady_clock::now());
+  if (problem.inventory) {
+    // Every subset is searched with the same table and incumbents, from the
+    // smallest, which the table answers at once, to the largest, which the
+    // incumbents found so far prune.  Shards split the subsets.
+    std::vector<Mask> subsets = inventory_subsets(problem);
+    path.push_back(first_position());
+    for (unsigned int idx = path.back(); idx < subsets.size(); ++idx) {
+      path.back() = idx;
+      if (((subsets[idx] * 2654435769u) >> 16) % params.shards != params.shard) continue;
+      network->values.clear();
+      for (Value i = 0; i < problem.size(); ++i) if (subsets[idx] >> i & 1) network->values.push_back(i);
+      solve(problem, network);
+      replaying = false;
+    }
+    path.pop_back();
+  } else if (params.shard == 0 || !table || problem.size() > table->m) {
+    // A problem that the table covers has no root masks, so it falls to shard 0.
+    solve(problem, network);
+  }
+  STAT(stats.search_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - search_start).count());
   delete network;
-  return best_network;
+  replay.clear();
+  if (!top.empty() && (!bounded || top.best()->ratio < lower_bound)) lower_bound = top.best()->ratio;
+  else if (top.empty() && !bounded) lower_bound = params.max_cost;
+  return top.best();
+}
+
+void Solver::offer(const Problem& problem, Node* network, const Ratio& cost) {
+  bool improves = top.empty() || cost < top.best()->ratio;
+  if (top.offer(problem, network, cost) && improves && (trace || observer)) {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (trace) print_trace(*trace, elapsed.count(), top.best(), stats);
+    if (observer) observer(elapsed.count(), top.best());
+  }
+}
+
+void Solver::seed(const Node* network) {
+  for (auto seed_network : seed_networks) delete seed_network;
+  seed_networks.assign(1, Node::parse(network->to_network()));
+}
+
+void Solver::set_checkpoint(const std::string& _path, double seconds) {
+  checkpoint_path = _path;
+  checkpoint_seconds = seconds;
+}
+
+const char CHECKPOINT_MAGIC[] = "network_opt-checkpoint-1";
+
+static std::string checkpoint_header(const Problem& problem, const Params& params) {
+  std::ostringstream os;
+  os << CHECKPOINT_MAGIC << " m=" << params.m << " k=" << params.k << " shard=" << params.shard << "/"
+     << params.shards << " max_cost=" << params.max_cost << " square=" << problem.square
+     << " kind=" << problem.kind << " inventory=" << problem.inventory << "/" << problem.max_parts
+     << " target=" << problem.target << " elements=";
+  for (auto& element : problem.elements) os << element << ",";
+  return os.str();
+}
+
+void Solver::save(const Problem& problem) {
+  std::string temporary = checkpoint_path + ".tmp";
+  std::ofstream file(temporary);
+  file << checkpoint_header(problem, params) << std::endl;
+  file << path.size();
+  for (auto position : path) file << " " << position;
+  file << std::endl;
+  for (auto network : top.all()) file << network->to_network() << std::endl;
+  file.close();
+  if (!file || std::rename(temporary.c_str(), checkpoint_path.c_str()) != 0)
+    checkpoint_status = absl::UnavailableError("cannot write " + checkpoint_path);
+}
+
+absl::Status Solver::resume(const Problem& problem, const std::string& _path) {
+  std::ifstream file(_path);
+  if (!file) return absl::NotFoundError("cannot read " + _path);
+  std::string header;
+  std::getline(file, header);
+  if (header != checkpoint_header(problem, params))
+    return absl::InvalidArgumentError(_path + " was saved for another problem or other parameters");
+  size_t depth = 0;
+  std::vector<unsigned int> positions;
+  file >> depth;
+  for (unsigned int position; positions.size() < depth && file >> position; ) positions.push_back(position);
+  if (positions.size() != depth) return absl::InvalidArgumentError("corrupt checkpoint: " + _path);
+  std::vector<Node*> networks;
+  for (std::string line; file >> line; ) {
+    Node* network = Node::parse(line);
+    if (!network) {
+      for (auto node : networks) delete node;
+      return absl::InvalidArgumentError("corrupt checkpoint: " + _path);
+    }
+    networks.push_back(network);
+  }
+  for (auto seed_network : seed_networks) delete seed_network;
+  seed_networks = networks;
+  replay = positions;
+  return absl::OkStatus();
 }
 
-void Solver::clear() {
-  if (best_network) delete best_network;
-  best_network = NULL;
+// Whether the current iteration of a loop belongs to this shard.  Shards
+// split the iterations of the root loop, which is the only loop at depth 1
+// since the table searches lead straight to leaves.  The exception is the
+// last root mask, which moves every element into a single child (so that
+// its subtree holds all networks of the other operator, about as many as
+// the rest together); its subtree is split at the next loop instead.
+bool Solver::in_shard(const Problem& problem, Mask mask) const {
+  Mask last_root_mask = (1 << (problem.size() - 1)) - 1;
+  if (path.size() == 1 && mask == last_root_mask) return true;
+  if (path.size() == 1 || (path.size() == 2 && path[0] == last_root_mask))
+    return ((mask * 2654435769u) >> 16) % params.shards == params.shard;  // Spreads neighbouring masks.
+  return true;
+}
+
+// Returns where the loop entered at the current depth should begin, which
+// is past the iterations that a resumed search had already completed.
+unsigned int Solver::first_position() {
+  if (replaying && path.size() < replay.size()) return replay[path.size()];
+  replaying = false;
+  return 0;
 }
 
 void Solver::solve(const Problem& problem, Node* network) {
-  if (bounder && best_network && bounder->bound(problem, network) >= best_network->ratio)
+  // Once the search stops, the loops below still pass every unexplored
+  // subtree here, where their bounds are gathered into a lower bound.
+  if (!stopped && (stopped = deadline.expired()) && !checkpoint_path.empty()) save(problem);
+  if (stopped || (top.full() && top.cutoff() <= params.tolerance)) {
+    Ratio bound = Bounder().bound(problem, network);
+    if (bound < 0) bound = 0;
+    if (!bounded || bound < lower_bound) lower_bound = bound;
+    bounded = true;
     return;
+  }
+  if (checkpoint_deadline.expired()) {
+    save(problem);
+    checkpoint_deadline = Deadline(checkpoint_seconds);
+  }
+  // A partial network that was visited before has had every completion
+  // offered or pruned against a cutoff at least as large as the current one.
+  if (transpositions.enabled() && transpositions.visit(canonical_hash(hashes, network))) {
+    STAT(++stats.transpositions);
+    return;
+  }
+  STAT(++stats.nodes);
+  if (bounder && (top.full() || params.max_cost >= 0)) {
+    STAT(++stats.bounds; stats.evaluations += 2);
+    Ratio bound = bounder->bound(problem, network);
+    if ((top.full() && bound >= top.cutoff()) || (params.max_cost >= 0 && bound > params.max_cost)) {
+      STAT(++stats.prunes);
+      return;
+    }
+  }
   Expander expander(network);
   Node* expandable_0 = expander.expandable();
   if (!expandable_0) {
-    Ratio cost = network_evaluator.evaluate_cost(problem, network);
-    if (!best_network || best_network->ratio > cost) {
-      if (best_network) delete best_network;
-      best_network = network->clone();
-      best_network->ratio = cost;
-    }
+    STAT(++stats.leaves; ++stats.evaluations);
+    Ratio cost = evaluator.evaluate_cost(problem, network);
+    if (params.max_cost < 0 || cost <= params.max_cost) offer(problem, network, cost);
     return;
   }
   Node* expandable_1 = expander.expandable();
   Node* expandable_2 = expandable_1 ? expander.expandable() : NULL;
   Values values_0 = expandable_0->values; expandable_0->values.clear();
-  if (tabulator && !expandable_1 && values_0.size() <= tabulator->m) {
-    Node* node = tabulator->binary_search(problem, network, expandable_0, values_0);
+  // Three or more expandables that all fit in the table.
+  std::vector<Node*> expandables;
+  if (table && expandable_2 && params.k == 1 && values_0.size() <= table->m) {
+    expandables = {expandable_0, expandable_1, expandable_2};
+    for (Node* node; (node = expander.expandable()); ) expandables.push_back(node);
+    for (unsigned int i = 1; i < expandables.size(); ++i)
+      if (expandables[i]->values.size() > table->m) expandables.clear();
+  }
+  if (table && !expandable_1 && values_0.size() <= table->m && params.k > 1) {
+    // The cost is unimodal over the sorted entries, so the k best distinct
+    // networks lie among the first k distinct ones on either side of the
+    // best entry.  Entries of equal totals may give the same network, so
+    // each side widens until it has k distinct networks.
+    STAT(++stats.binary_searches);
+    Node* node = table->binary_search(problem, network, expandable_0, values_0, &stats);
+    const std::vector<std::pair<Ratio, Node*>>& entry = table->lookup_table[coder.encode(values_0)];
+    int best = std::find_if(entry.begin(), entry.end(), [&](const auto& x) { return x.second == node; })
+        - entry.begin();
+    std::vector<unsigned int> window;
+    for (int step : {-1, 1}) {
+      std::set<uint64_t> distinct;
+      for (int idx = (step < 0) ? best : best + 1; idx >= 0 && idx < (int) entry.size() &&
+           distinct.size() < params.k; idx += step) {
+        expandable_0->children.push_back(entry[idx].second);
+        if (distinct.insert(canonical_hash(hashes, network)).second) window.push_back(idx);
+        expandable_0->children.pop_back();
+      }
+    }
+    path.push_back(first_position());
+    for (unsigned int position = path.back(); position < window.size(); ++position) {
+      path.back() = position;
+      expandable_0->children.push_back(entry[window[position]].second);
+      solve(problem, network);
+      replaying = false;
+      expandable_0->children.pop_back();
+    }
+    path.pop_back();
+  } else if (table && !expandable_1 && values_0.size() <= table->m) {
+    STAT(++stats.binary_searches);
+    Node* node = table->binary_search(problem, network, expandable_0, values_0, &stats);
     expandable_0->children.push_back(node);
     solve(problem, network);
     expandable_0->children.pop_back();
-  } else if (tabulator && expandable_1 && !expandable_2 &&
-             values_0.size() <= tabulator->m &&
-             expandable_1->values.size() <= tabulator->m) {
+  } else if (table && expandable_1 && !expandable_2 && params.k == 1 &&
+             values_0.size() <= table->m &&
+             expandable_1->values.size() <= table->m) {
     Values values_1 = expandable_1->values; expandable_1->values.clear();
-    std::pair<Node*,Node*> nodes = tabulator->linear_search(
-        problem, network, expandable_0, expandable_1, values_0, values_1);
+    STAT(++stats.linear_searches);
+    std::pair<Node*,Node*> nodes = table->linear_search(
+        problem, network, expandable_0, expandable_1, values_0, values_1, &stats);
     expandable_0->children.push_back(nodes.first);
     expandable_1->children.push_back(nodes.second);
     solve(problem, network);
     expandable_1->children.pop_back();
     expandable_0->children.pop_back();
     expandable_1->values = values_1;
+  } else if (!expandables.empty()) {
+    std::vector<Values> values(1, values_0);
+    for (unsigned int i = 1; i < expandables.size(); ++i) {
+      values.push_back(expandables[i]->values);
+      expandables[i]->values.clear();
+    }
+    STAT(++stats.multi_searches);
+    // Choices that cost no less than the cutoff would be pruned anyway.
+    Ratio cutoff = top.full() ? top.cutoff() : Ratio(-1);
+    std::vector<Node*> nodes = table->multi_search(problem, network, expandables, values, cutoff, &stats);
+    for (unsigned int i = 0; i < nodes.size(); ++i) expandables[i]->children.push_back(nodes[i]);
+    if (!nodes.empty()) solve(problem, network);
+    for (unsigned int i = 0; i < expandables.size(); ++i) {
+      if (!nodes.empty()) expandables[i]->children.pop_back();
+      if (i) expandables[i]->values = values[i];
+    }
   } else {
     bool has_children = !expandable_0->children.empty();
     Node* child = &N();
     expandable_0->children.push_back(child);
     Mask max_mask = 1 << (values_0.size() - 1);
-    for (Mask mask = 0; mask < max_mask; ++mask) {
+    path.push_back(first_position());
+    for (Mask mask = path.back(); mask < max_mask; ++mask) {
+      if (params.shards > 1 && !problem.inventory && !in_shard(problem, mask)) continue;
+      path.back() = mask;
       coder.decode(mask, values_0, child->values, expandable_0->values);
       if (has_children || !expandable_0->values.empty() || expandable_0 == network)
         solve(problem, network);
+      replaying = false;
       child->values.clear();
       expandable_0->values.clear();
     }
+    path.pop_back();
     expandable_0->children.pop_back();
     delete child;
   }
   expandable_0->values = values_0;
 }
 
-void print_summary(std::ostream& os, const Problem& problem, Node* network, const std::string& prefix) {
-  Ratio total = network_evaluator.evaluate_total(problem, network);
-  double cost = boost::rational_cast<double>(problem.get_cost(total));
+bool parse_ratio(const std::string& s, Ratio* ratio) {
+  size_t slash = s.find('/'), dot = s.find('.');
+  std::string num = s, den = "1";
+  if (slash != std::string::npos) {
+    num = s.substr(0, slash); den = s.substr(slash + 1);
+  } else if (dot != std::string::npos) {
+    num = s.substr(0, dot) + s.substr(dot + 1); den = "1" + std::string(s.size() - dot - 1, '0');
+  }
+  if (num.empty() || den.empty() || num.size() > 100 || den.size() > 100) return false;
+  if (num.find_first_not_of("0123456789") != std::string::npos) return false;
+  if (den.find_first_not_of("0123456789") != std::string::npos) return false;
+  // cpp_int reads a leading zero as octal (and rejects "09"), so drop them.
+  num.erase(0, std::min(num.find_first_not_of('0'), num.size() - 1));
+  den.erase(0, std::min(den.find_first_not_of('0'), den.size() - 1));
+  if (cpp_int(den) == 0) return false;
+  *ratio = Ratio(cpp_int(num), cpp_int(den));
+  return true;
+}
+
+// Returns the target and the cost as they are reported to the user, where
+// square problems are reported in terms of the square root of their target,
+// and costs in the units of the target.
+static std::pair<double, double> summarize(const Problem& problem, const Ratio& total) {
+  double cost = boost::rational_cast<double>(problem.measure(total) - problem.target);
   double target = boost::rational_cast<double>(problem.target);
   if (problem.square) {
     target = std::sqrt(target);
-    cost = boost::rational_cast<double>(total) - target;
+    cost = boost::rational_cast<double>(problem.measure(total)) - target;
   }
+  return std::make_pair(target, cost);
+}
+
+static void print_stats(std::ostream& os, const Stats& stats, const std::string& prefix) {
+  if (!Stats::enabled) {
+    os << prefix << "   Stats: not gathered (built without NETWORK_OPT_STATS)" << std::endl;
+    return;
+  }
+  os << prefix << "   Nodes: " << stats.nodes << " visited, " << stats.bounds << " bounded, "
+     << stats.prunes << " pruned, " << stats.leaves << " complete" << std::endl;
+  if (stats.restarts) os << prefix << "Restarts: " << stats.restarts << std::endl;
+  os << prefix << "Searches: " << stats.binary_searches << " binary, " << stats.linear_searches << " linear, "
+     << stats.multi_searches << " multi, " << stats.probes << " probes" << std::endl;
+  os << prefix << "   Evals: " << stats.evaluations << std::endl;
+  if (stats.transpositions) os << prefix << "   Table: " << stats.transpositions << " transpositions" << std::endl;
+  os << std::setprecision(4);
+  os << prefix << "    Time: " << stats.tabulate_seconds << " s tabulating " << stats.entries << " entries, "
+     << stats.search_seconds << " s searching" << std::endl;
+}
+
+void print_summary(std::ostream& os, const Problem& problem, Node* network, const std::string& prefix,
+                   const Stats* stats) {
+  NetworkEvaluator evaluator;
+  Ratio total = evaluator.evaluate_total(problem, network);
+  auto [target, cost] = summarize(problem, total);
+  total = problem.measure(total);
   os << prefix << "Solution: " << network->to_string(problem) << std::endl;
   os << prefix << " Network: " << network->to_network() << std::endl;
   os << std::setprecision(16);
@@ -402,6 +1251,38 @@ void print_summary(std::ostream& os, const Problem& problem, Node* network, cons
   os << prefix << "   Total: " << boost::rational_cast<double>(total) << " (" << total << ")" << std::endl;
   os << std::setprecision(4);
   os << prefix << "    Cost: " << cost << std::endl;
+  if (stats) print_stats(os, *stats, prefix);
+}
+
+void print_trace(std::ostream& os, double seconds, const Node* network, const Stats& stats) {
+  os << "{\"seconds\":" << seconds << ",\"cost\":" << boost::rational_cast<double>(network->ratio)
+     << ",\"exact_cost\":\"" << network->ratio << "\"";
+  if (Stats::enabled) os << ",\"nodes\":" << stats.nodes;
+  os << ",\"network\":\"" << network->to_network() << "\"}" << std::endl;
+}
+
+std::string json_escape(const std::string& s) {
+  std::string escaped;
+  for (char c : s) {
+    if (c == '"' || c == '\\') escaped += '\\';
+    if (c >= ' ') escaped += c;
+  }
+  return escaped;
+}
+
+void print_json_fields(std::ostream& os, const Problem& problem, Node* network) {
+  NetworkEvaluator evaluator;
+  Ratio total = evaluator.evaluate_total(problem, network);
+  auto [target, cost] = summarize(problem, total);
+  total = problem.measure(total);
+  os << "\"solution\":\"" << network->to_string(problem) << "\",";
+  os << "\"network\":\"" << network->to_network() << "\",";
+  os << std::setprecision(16);
+  os << "\"target\":" << target << ",";
+  os << "\"total\":" << boost::rational_cast<double>(total) << ",";
+  os << "\"exact_total\":\"" << total << "\",";
+  os << std::setprecision(4);
+  os << "\"cost\":" << cost;
 }
 
 }
@@ -14,10 +14,16 @@ limitations under the License.
 #ifndef _NETWORK_OPT_H_
 #define _NETWORK_OPT_H_
 
+#include "absl/status/statusor.h"
+
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <boost/multiprecision/cpp_int.hpp>
 #include <boost/rational.hpp>
+#include <chrono>
+#include <functional>
+#include <iomanip>
 #include <iostream>
 #include <list>
 #include <math.h>
@@ -37,28 +43,65 @@ using Values = std::list<Value>;
 
 namespace network_opt {
 
-extern Ratio RATIO_E;
-extern Ratio RATIO_PI;
-extern Ratio RATIO_PHI;
-extern Ratio RATIO_SQRT2;
+extern const Ratio RATIO_E;
+extern const Ratio RATIO_PI;
+extern const Ratio RATIO_PHI;
+extern const Ratio RATIO_SQRT2;
 
-extern Ratio INT_SERIES[];
-extern Ratio E12_SERIES[];
-extern Ratio ONE_SERIES[];
+extern const Ratio INT_SERIES[];
+extern const Ratio E12_SERIES[];
+extern const Ratio ONE_SERIES[];
 
 struct Problem {
+  // What the elements and the target measure.  Capacitances add in parallel
+  // and their reciprocals in series, so a capacitor network is solved as the
+  // resistor network over the same values with series and parallel swapped,
+  // and only printed differently.  A CONDUCTANCE problem has resistors for
+  // elements and a conductance for its target, which a network meets when
+  // the reciprocal of its resistance does.  Either way the resistor tables
+  // of the elements serve every kind.
+  enum Kind { RESISTANCE, CAPACITANCE, CONDUCTANCE };
+
   std::vector<Ratio> elements;
   Ratio target;
   bool square;
+  Kind kind = RESISTANCE;
+  // If set, the elements are an inventory of parts, and a network may use
+  // any nonempty subset of them (of at most max_parts, unless it is zero).
+  // A supply problem (see SupplyTable) instead draws at most max_parts parts
+  // from its elements with repetition.
+  bool inventory = false;
+  unsigned int max_parts = 0;
 
-  static Problem from_argv(char* argv[]);
+  // Builds a problem from its command-line spelling, e.g. ("E12", "4", "SQRT").
+  // The target is either a named constant or a literal such as "2.5" or "7/3".
+  static absl::StatusOr<Problem> from_spec(const std::string& series, const std::string& n,
+                                           const std::string& target);
+  // Builds the supply problem of at most k parts drawn from the distinct
+  // values of a series, e.g. ("E12", "5", "3.3"), where SQRT means sqrt(k).
+  static absl::StatusOr<Problem> from_supply_spec(const std::string& series, const std::string& k,
+                                                  const std::string& target);
 
   Problem(const Ratio* series, unsigned int n, const Ratio& t, bool s);
   unsigned int size() const;
   const Ratio& operator[](unsigned int idx) const;
+  // Signed, and increasing in the total (the resistance of the network, or
+  // the capacitance of a CAPACITANCE problem).
   Ratio get_cost(const Ratio& total) const;
+  // The total in the units of the target: the conductance of a CONDUCTANCE problem.
+  Ratio measure(const Ratio& total) const;
+  // The symbol of a series ('+') or parallel ('|') composition of resistors
+  // as it is printed for this kind of problem.
+  char symbol(char op) const;
 };
 
+bool parse_kind(const std::string& s, Problem::Kind* kind);
+
+// The masks of the subsets of elements that the networks of an inventory
+// problem may use, smallest first, leaving out those that only swap equal
+// elements with other subsets.  Just the full mask for other problems.
+std::vector<Mask> inventory_subsets(const Problem& problem);
+
 struct Node {
   Values values; Values hidden; std::list<Node*> children; Ratio ratio;
   static Node& create();
@@ -76,19 +119,59 @@ struct Node {
   void leafify();
   std::string to_string(const Problem& problem, bool mathmode = false, bool top = true, char op1 = '+', char op2 = '|') const;
   std::string to_network(char op1 = '+', char op2 = '|') const;
+  // Inverse of to_network(); returns NULL if the string is malformed.  The
+  // result shares no nodes with any table, so parse(n->to_network()) is
+  // also a deep copy of n.
+  static Node* parse(const std::string& network);
 
  private: Node() {}
+  static Node* parse(const std::string& network, size_t& pos);
 };
 
-struct NetworkEvaluator {
-  Ratio evaluate_total(const Problem& problem, const Node* node, int bound = 0, char op1 = '+', char op2 = '|');
-  Ratio evaluate_cost(const Problem& problem, const Node* node, int bound = 0);
+// The mask of the elements that network uses.
+Mask used_elements(const Node* network);
+
+// Moves values into children of their own until every node has at most two
+// values and no children, or one value among its children, which is how
+// NetworkEvaluator expects the terms of a complete network to be spread.
+void spread_values(Node* network);
+
+// Returns a string that is equal for two networks whenever they differ only
+// in the order of their series or parallel terms, or in which of several
+// equal elements they use.
+std::string canonical_network(const Problem& problem, const Node* network);
+
+// A 64-bit hash of canonical_network() that is much cheaper to compute,
+// given element_hashes() of the problem.  It also applies to partial
+// networks, whose nodes still to be expanded hash their values as a set.
+uint64_t canonical_hash(const std::vector<uint64_t>& element_hashes, const Node* network);
+// Hashes of the elements of the problem, which are equal for equal elements.
+std::vector<uint64_t> element_hashes(const Problem& problem);
+
+// The total of a network as a function of the totals x and y of up to two
+// of its nodes (the holes), which table searches compile once and then
+// evaluate for every pair of entries they try, instead of walking the whole
+// network each time.  Series and parallel compositions keep it a ratio of
+// polynomials linear in each of x and y, whose coefficients are indexed by
+// the bits x = 1 and y = 2.  The coefficients are scaled to integers, so
+// that each total takes integer products and a single reduction.
+struct HoleFunction {
+  cpp_int numerator[4], denominator[4];
+  Ratio operator()(const Ratio& x, const Ratio& y) const;
 };
 
-extern NetworkEvaluator network_evaluator;
+struct NetworkEvaluator {
+  Ratio evaluate_total(const Problem& problem, const Node* node, int bound = 0, char op1 = '+', char op2 = '|') const;
+  Ratio evaluate_cost(const Problem& problem, const Node* node, int bound = 0) const;
+  // Agrees with evaluate_total() (for bound 0) whatever totals the holes
+  // have, which must be table entries; hole_y may be NULL.
+  HoleFunction evaluate_holes(const Problem& problem, const Node* node, const Node* hole_x, const Node* hole_y,
+                              char op1 = '+', char op2 = '|') const;
+};
 
 struct Bounder {
   Ratio bound(const Problem& problem, const Node* network);
+ private: NetworkEvaluator evaluator;
 };
 
 struct Expander {
@@ -98,45 +181,219 @@ struct Expander {
 };
 
 struct SubsetCoder {
-  void decode(Mask mask, const Values& values, Values& include, Values& exclude);
-  Mask encode(const Values& values);
+  void decode(Mask mask, const Values& values, Values& include, Values& exclude) const;
+  Mask encode(const Values& values) const;
+};
+
+// Counts of search events.  They are only gathered if NETWORK_OPT_STATS is
+// defined at compile time; otherwise STAT() discards its statements.
+#ifdef NETWORK_OPT_STATS
+#define STAT(statements) statements
+#else
+#define STAT(statements)
+#endif
+
+struct Stats {
+#ifdef NETWORK_OPT_STATS
+  static constexpr bool enabled = true;
+#else
+  static constexpr bool enabled = false;
+#endif
+  unsigned long long nodes = 0;            // Partial networks (or LocalSolver moves) visited.
+  unsigned long long bounds = 0;           // Calls to Bounder::bound().
+  unsigned long long prunes = 0;           // Bounds that pruned the subtree.
+  unsigned long long leaves = 0;           // Complete networks evaluated.
+  unsigned long long restarts = 0;         // Random restarts (LocalSolver only).
+  unsigned long long binary_searches = 0;
+  unsigned long long linear_searches = 0;
+  unsigned long long multi_searches = 0;   // Table searches over three or more expandables.
+  unsigned long long probes = 0;           // Table entries tried by either search.
+  unsigned long long evaluations = 0;      // Totals computed, by evaluate_total() or a HoleFunction.
+  unsigned long long entries = 0;          // Table entries tabulated.
+  unsigned long long transpositions = 0;   // Partial networks skipped as already visited.
+  double tabulate_seconds = 0, search_seconds = 0;
 };
 
-extern SubsetCoder coder;
+// Called with each network and its total; returns whether to go on.  The
+// network is only valid during the call, and is reused by the next one.
+using NetworkVisitor = std::function<bool(const Node* network, const Ratio& total)>;
+
+// Visits every series-parallel network over the elements in mask, in the
+// order in which Tabulator lists them before sorting, using memory
+// proportional to the number of elements.  Returns whether every network was
+// visited (rather than stopped by the visitor).
+bool enumerate_networks(const Problem& problem, Mask mask, const NetworkVisitor& visit);
 
 struct Tabulator {
   unsigned int m; std::vector<std::vector<std::pair<Ratio, Node*>>> lookup_table;
+  Stats stats;  // Of the last call to tabulate().
   Tabulator(unsigned int _m) : m(_m) { }
   ~Tabulator() { clear(); }
 
   void tabulate(const Problem& problem);
-  Node* binary_search(const Problem& problem, const Node* network, Node* expandable, const Values& values);
+  // Both searches count their probes into stats, if not NULL.
+  Node* binary_search(const Problem& problem, const Node* network, Node* expandable, const Values& values,
+                      Stats* stats = NULL) const;
   std::pair<Node*,Node*> linear_search(const Problem& problem, const Node* network, Node* expandable_0,
-      Node* expandable_1, const Values& values_0, const Values& values_1);
+      Node* expandable_1, const Values& values_0, const Values& values_1, Stats* stats = NULL) const;
+  // Generalizes linear_search() to three or more expandables, each with the
+  // values it had: the outer ones try their entries in order of total, while
+  // the two with the most entries are matched by linear_search().  Since the
+  // total grows with each entry, outer entries are only tried while the other
+  // expandables at their smallest and largest entries show that they can
+  // beat the best cost so far.  Returns an entry per expandable, or nothing
+  // if no choice costs less than cutoff (unless it is negative).
+  std::vector<Node*> multi_search(const Problem& problem, const Node* network, const std::vector<Node*>& expandables,
+                                  const std::vector<Values>& values, const Ratio& cutoff = -1,
+                                  Stats* stats = NULL) const;
+  // The bytes held by the objects that make up the table, without allocator overhead.
+  size_t bytes() const;
+  // Writes the table to path, from which load() reads it back in place of
+  // tabulate() for any problem with the same elements, whatever its kind.
+  absl::Status save(const Problem& problem, const std::string& path) const;
+  absl::Status load(const Problem& problem, const std::string& path);
 
  private:
+  NetworkEvaluator evaluator; SubsetCoder coder;
   void clear();
   void tabulate(const Problem& problem, Node* network, Mask mask = 0, Value i = 0);
-  void tabulate(const Problem& problem, Node* network, std::vector<std::pair<Ratio, Node*>>& entry);
+  void multi_search(const Problem& problem, const Node* network, const std::vector<Node*>& expandables,
+                    const std::vector<Values>& values, unsigned int depth, std::vector<Node*>& best,
+                    Ratio& best_cost, Stats* stats) const;
+};
+
+// The estimated size of a Tabulator(m) for n elements, and the time to
+// tabulate it.  A network of k elements is taken to have k nodes, which is
+// close to the average, and the time is calibrated against BM_Tabulate of
+// network_opt_bench.
+struct TableEstimate {
+  unsigned long long entries = 0;
+  double bytes = 0, seconds = 0;
 };
+TableEstimate estimate_table(unsigned int n, unsigned int m);
+// The largest m whose table for n elements fits in max_bytes and (if not
+// zero) max_seconds, or zero if even the table of single elements does not.
+unsigned int choose_m(unsigned int n, double max_bytes, double max_seconds = 0);
 
 struct Params {
   bool b;
   unsigned int m;
+  double time_limit = 0;  // In seconds; zero means no limit.
+  unsigned int k = 1;  // Number of distinct networks to keep.
+  Ratio tolerance = 0;  // Searches stop once the k best costs are at most this.
+  // Solver searches only the root masks equal to shard modulo shards, so
+  // that shards 0 to shards - 1 together cover the whole search.
+  unsigned int shard = 0, shards = 1;
+  Ratio max_cost = -1;  // If not negative, Solver neither keeps nor expands networks costing more.
+  unsigned int transposition_bits = 0;  // Solver remembers 2^bits visited partial networks (if not 0).
+  // If not NULL, searches stop as if their time limit had passed soon
+  // after another thread sets *cancel.
+  const std::atomic<bool>* cancel = NULL;
   Params(bool _b, unsigned int _m) : b(_b), m(_m) {}
 };
 
+// Tracks an optional wall-clock limit and cancellation flag, reading them
+// only every stride calls.
+struct Deadline {
+  Deadline(double seconds = 0, unsigned int stride = 256, const std::atomic<bool>* cancel = NULL);
+  bool expired();
+ private: std::chrono::steady_clock::time_point end; bool limited; bool passed; unsigned int stride, calls;
+  const std::atomic<bool>* cancel;
+};
+
+// Called with the seconds since a search started and each new best network
+// it finds, which is only valid during the call.
+using IncumbentObserver = std::function<void(double seconds, const Node* network)>;
+
+// The k best networks offered so far, in order of increasing cost, of which
+// no two share a canonical_network() (checked only if k > 1).  Each kept
+// network is a clone whose ratio holds its cost.
+struct TopNetworks {
+  TopNetworks(unsigned int _k = 1) : k(_k) {}
+  ~TopNetworks() { clear(); }
+  // Keeps a clone of network if it is among the k best; returns whether it was kept.
+  bool offer(const Problem& problem, Node* network, const Ratio& cost);
+  bool empty() const { return networks.empty(); }
+  // Once full, only networks cheaper than cutoff() can be kept.
+  bool full() const { return networks.size() >= k; }
+  const Ratio& cutoff() const { return networks.back()->ratio; }
+  Node* best() const { return networks.empty() ? NULL : networks.front(); }
+  const std::vector<Node*>& all() const { return networks; }
+  void clear();
+ private: unsigned int k; std::vector<Node*> networks; std::vector<std::string> canonicals;
+};
+
+// A direct-mapped set of 2^bits canonical hashes, where each new hash
+// evicts the one in its slot.
+struct TranspositionTable {
+  TranspositionTable(unsigned int bits = 0) : slots(bits ? 1ull << bits : 0) {}
+  bool enabled() const { return !slots.empty(); }
+  // Returns whether hash is present, and otherwise inserts it.
+  bool visit(uint64_t hash);
+  void clear() { std::fill(slots.begin(), slots.end(), 0); }
+ private: std::vector<uint64_t> slots;
+};
+
 struct Solver {
   Solver(const Params& params);
+  // Searches with a table that the caller has already tabulated for the
+  // problems passed to solve(); it may be shared by concurrent solvers.
+  Solver(const Params& params, const Tabulator* shared_tabulator);
   ~Solver();
+  // Returns the best network found, which is optimal unless timed_out() or
+  // params.tolerance is non-zero.
   Node* solve(const Problem& problem);
+  // The params.k best distinct networks found by the last solve(), best first.
+  const std::vector<Node*>& solutions() const { return top.all(); }
+  // Of the last call to solve(), including tabulation by an owned Tabulator.
+  const Stats& get_stats() const { return stats; }
+  const Tabulator* get_table() const { return table; }
+  bool timed_out() const { return stopped; }
+  // A proven lower bound on the cost of every network, which equals the cost
+  // of the best network found if the last search ran to completion.
+  const Ratio& get_lower_bound() const { return lower_bound; }
+  // Writes a JSON line to os (if not NULL) for every new best network.
+  void set_trace(std::ostream* os) { trace = os; }
+  void set_observer(const IncumbentObserver& _observer) { observer = _observer; }
+  // Makes the given network the incumbent of the next call to solve(), so
+  // that the Bounder prunes against it from the first node onward.
+  void seed(const Node* network);
 
- private: Bounder* bounder; Tabulator* tabulator; Node* best_network;
-  void clear();
+  // Makes solve() save its state to path every given number of seconds, and
+  // once more if it stops early.  The state is the position of every loop
+  // on the search stack along with the incumbents, so it stays small.
+  void set_checkpoint(const std::string& path, double seconds);
+  // The outcome of the last save made by solve(), if any.
+  const absl::Status& get_checkpoint_status() const { return checkpoint_status; }
+  // Makes the next call to solve() (for the same problem and params.m and
+  // params.k) continue from a saved state instead of starting over.
+  absl::Status resume(const Problem& problem, const std::string& path);
+
+ private: Params params; Bounder* bounder; Tabulator* tabulator; const Tabulator* table; TopNetworks top;
+  std::vector<Node*> seed_networks;
+  NetworkEvaluator evaluator; SubsetCoder coder; Deadline deadline; bool stopped; Stats stats;
+  std::ostream* trace; std::chrono::steady_clock::time_point start; Ratio lower_bound; bool bounded;
+  std::string checkpoint_path; double checkpoint_seconds; Deadline checkpoint_deadline;
+  absl::Status checkpoint_status; std::vector<unsigned int> path, replay; bool replaying;
+  TranspositionTable transpositions; std::vector<uint64_t> hashes; IncumbentObserver observer;
+  void offer(const Problem& problem, Node* network, const Ratio& cost);
+  void save(const Problem& problem);
+  unsigned int first_position();
+  bool in_shard(const Problem& problem, Mask mask) const;
   void solve(const Problem& problem, Node* network);
 };
 
-void print_summary(std::ostream& os, const Problem& problem, Node* network, const std::string& prefix);
+bool parse_ratio(const std::string& s, Ratio* ratio);
+
+// Also prints stats, if not NULL.
+void print_summary(std::ostream& os, const Problem& problem, Node* network, const std::string& prefix,
+                   const Stats* stats = NULL);
+// Writes the solution, network, total and cost as comma-separated JSON fields.
+void print_json_fields(std::ostream& os, const Problem& problem, Node* network);
+std::string json_escape(const std::string& s);
+// Writes a JSON line describing an incumbent (whose ratio holds its cost)
+// found after the given number of seconds.
+void print_trace(std::ostream& os, double seconds, const Node* network, const Stats& stats);
 
 }
 
@@ -0,0 +1,96 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "network_opt_async.h"
+
+namespace network_opt {
+
+AsyncSolve::AsyncSolve(const Problem& _problem, const Params& _params, SolveMethod _method,
+                       const Tabulator* shared_tabulator, const IncumbentCallback& _callback,
+                       const EvolutionParams& _evolution)
+    : problem(_problem), params(_params), method(_method), table(shared_tabulator), callback(_callback),
+      evolution(_evolution), cancelled(false), found(false) {
+  params.cancel = &cancelled;
+  std::packaged_task<SolveResult()> task([this]() { return run(); });
+  future = task.get_future().share();
+  thread = std::thread(std::move(task));
+}
+
+AsyncSolve::~AsyncSolve() {
+  cancel();
+  thread.join();
+}
+
+bool AsyncSolve::best(Incumbent* _incumbent) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (found) *_incumbent = incumbent;
+  return found;
+}
+
+std::vector<Incumbent> AsyncSolve::poll() {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<Incumbent> polled(incumbents.begin(), incumbents.end());
+  incumbents.clear();
+  return polled;
+}
+
+void AsyncSolve::observe(double seconds, const Node* network) {
+  Incumbent update = {seconds, network->ratio, network->to_network()};
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    incumbents.push_back(update);
+    incumbent = update;
+    found = true;
+  }
+  if (callback) callback(update);
+}
+
+SolveResult AsyncSolve::run() {
+  auto start = std::chrono::steady_clock::now();
+  auto observer = [this](double seconds, const Node* network) { observe(seconds, network); };
+  SolveResult result;
+  const Node* network = NULL;
+  std::unique_ptr<Solver> opt;
+  std::unique_ptr<LocalSolver> local;
+  std::unique_ptr<EvolutionSolver> evolve;
+  if (method == SolveMethod::OPT) {
+    opt = table ? std::make_unique<Solver>(params, table) : std::make_unique<Solver>(params);
+    opt->set_observer(observer);
+    network = opt->solve(problem);
+    result.lower_bound = opt->get_lower_bound();
+    result.optimal = !opt->timed_out() && !params.tolerance;
+    result.stats = opt->get_stats();
+  } else if (method == SolveMethod::LOCAL) {
+    local = table ? std::make_unique<LocalSolver>(params, table, 2022, nullptr)
+                  : std::make_unique<LocalSolver>(params, 2022, nullptr);
+    local->set_observer(observer);
+    network = local->solve(problem);
+    result.stats = local->get_stats();
+  } else {
+    evolve = table ? std::make_unique<EvolutionSolver>(params, table, evolution)
+                   : std::make_unique<EvolutionSolver>(params, evolution);
+    evolve->set_observer(observer);
+    network = evolve->solve(problem);
+    result.stats = evolve->get_stats();
+  }
+  if (network) {
+    result.network.reset(Node::parse(network->to_network()));
+    result.cost = network->ratio;
+  }
+  result.cancelled = cancelled.load(std::memory_order_relaxed);
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+
+}
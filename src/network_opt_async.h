@@ -0,0 +1,85 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#ifndef _NETWORK_OPT_ASYNC_H_
+#define _NETWORK_OPT_ASYNC_H_
+
+#include "network_opt_evolve.h"
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace network_opt {
+
+enum class SolveMethod { OPT, LOCAL, EVOLVE };
+
+// A new best network found by an asynchronous solve.
+struct Incumbent {
+  double seconds = 0;  // Since the search started.
+  Ratio cost = -1;
+  std::string network;  // As printed by Node::to_network().
+};
+
+// The outcome of an asynchronous solve.
+struct SolveResult {
+  std::shared_ptr<const Node> network;  // NULL if none was found.
+  Ratio cost = -1;
+  Ratio lower_bound = 0;  // Proven by OPT; 0 for the other methods.
+  bool optimal = false;   // Whether OPT finished with no tolerance.
+  bool cancelled = false;
+  Stats stats;
+  double seconds = 0;
+};
+
+using IncumbentCallback = std::function<void(const Incumbent&)>;
+
+// Solves a copy of a problem on a thread of its own.  The caller can wait
+// on result(), poll the incumbents as they are found or receive them in a
+// callback (called on the solving thread), and cancel() the search, which
+// then stops within a few table searches as if params.time_limit had
+// passed: OPT returns its best network with a lower bound, and LOCAL, which
+// otherwise runs until its time limit or tolerance, returns its best.
+// Tabulation is not interrupted.  Destroying the handle cancels the search
+// and waits for it.
+struct AsyncSolve {
+  // shared_tabulator (if not NULL) must be tabulated for the problem and
+  // outlive the handle; otherwise the solver tabulates its own table.
+  AsyncSolve(const Problem& problem, const Params& params, SolveMethod method = SolveMethod::OPT,
+             const Tabulator* shared_tabulator = NULL, const IncumbentCallback& callback = nullptr,
+             const EvolutionParams& evolution = EvolutionParams());
+  AsyncSolve(const AsyncSolve&) = delete;
+  AsyncSolve& operator=(const AsyncSolve&) = delete;
+  ~AsyncSolve();
+  std::shared_future<SolveResult> result() const { return future; }
+  void cancel() { cancelled.store(true, std::memory_order_relaxed); }
+  bool done() const { return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+  // Sets *incumbent to the best network found so far, if there is one.
+  bool best(Incumbent* incumbent) const;
+  // Removes and returns the incumbents found since the last call, oldest first.
+  std::vector<Incumbent> poll();
+
+ private:
+  Problem problem; Params params; SolveMethod method; const Tabulator* table; IncumbentCallback callback;
+  EvolutionParams evolution; std::atomic<bool> cancelled; std::shared_future<SolveResult> future;
+  mutable std::mutex mutex; std::deque<Incumbent> incumbents; Incumbent incumbent; bool found;
+  std::thread thread;
+  SolveResult run();
+  void observe(double seconds, const Node* network);
+};
+
+}
+
+#endif
@@ -0,0 +1,129 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "network_opt_batch.h"
+#include "network_opt_multi.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+namespace network_opt {
+
+struct BatchJob {
+  unsigned int line; std::string spec; Problem problem; const Tabulator* table;
+};
+
+BatchSolver::BatchSolver(const Params& _params, unsigned int _threads, bool _single_pass)
+    : params(_params), threads(std::max(_threads, 1u)), single_pass(_single_pass) {}
+
+BatchSolver::~BatchSolver() {
+  for (auto& [key, table] : tables) delete table;
+}
+
+const Tabulator* BatchSolver::get_table(const std::string& series, const Problem& problem) {
+  if (!params.m) return NULL;
+  Tabulator*& table = tables[std::make_pair(series, problem.size())];
+  if (!table) {
+    table = new Tabulator(params.m);
+    table->tabulate(problem);
+  }
+  return table;
+}
+
+unsigned int BatchSolver::solve(std::istream& is, std::ostream& os) {
+  // Each item of the queue is solved in one pass: a single specification,
+  // or with single_pass every specification of a (series, n) pair.
+  std::deque<std::vector<BatchJob>> queue;
+  std::mutex queue_mutex;
+  std::condition_variable queue_cv;
+  bool done = false;
+  auto work = [&]() {
+    while (true) {
+      std::unique_lock<std::mutex> lock(queue_mutex);
+      queue_cv.wait(lock, [&]() { return done || !queue.empty(); });
+      if (queue.empty()) return;
+      std::vector<BatchJob> jobs = std::move(queue.front()); queue.pop_front();
+      lock.unlock();
+      queue_cv.notify_all();
+      auto start = std::chrono::steady_clock::now();
+      std::unique_ptr<Solver> solver;
+      std::unique_ptr<MultiSolver> multi_solver;
+      std::vector<Node*> networks;
+      if (jobs.size() == 1) {
+        solver = std::make_unique<Solver>(params, jobs[0].table);
+        networks.push_back(solver->solve(jobs[0].problem));
+      } else {
+        std::vector<Problem> problems;
+        for (auto& job : jobs) problems.push_back(job.problem);
+        multi_solver = std::make_unique<MultiSolver>(params, jobs[0].table);
+        networks = multi_solver->solve(problems);
+      }
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      std::ostringstream lines;
+      for (unsigned int i = 0; i < jobs.size(); ++i) {
+        lines << "{\"line\":" << jobs[i].line << ",\"spec\":\"" << json_escape(jobs[i].spec) << "\",";
+        // A search with params.max_cost may find no network within it.
+        if (networks[i]) print_json_fields(lines, jobs[i].problem, networks[i]);
+        else lines << "\"network\":null";
+        lines << ",\"seconds\":" << elapsed.count() << "}" << std::endl;
+      }
+      std::lock_guard<std::mutex> output_lock(output_mutex);
+      os << lines.str() << std::flush;
+    }
+  };
+  std::vector<std::thread> workers;
+  for (unsigned int i = 0; i < threads; ++i) workers.emplace_back(work);
+  auto enqueue = [&](std::vector<BatchJob>&& jobs) {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    // Keep the queue short so that results keep streaming for long inputs.
+    queue_cv.wait(lock, [&]() { return queue.size() < 4 * threads; });
+    queue.push_back(std::move(jobs));
+    lock.unlock();
+    queue_cv.notify_all();
+  };
+  std::map<std::pair<std::string, unsigned int>, std::vector<BatchJob>> groups;
+  std::string spec;
+  unsigned int line = 0, count = 0;
+  while (std::getline(is, spec)) {
+    ++line;
+    std::istringstream tokens(spec);
+    std::string series, n, target, extra;
+    if (!(tokens >> series)) continue;  // Skip blank lines.
+    ++count;
+    absl::StatusOr<Problem> problem = absl::InvalidArgumentError("expected <series> <n> <target>");
+    if (tokens >> n >> target && !(tokens >> extra)) problem = Problem::from_spec(series, n, target);
+    if (!problem.ok()) {
+      std::lock_guard<std::mutex> output_lock(output_mutex);
+      os << "{\"line\":" << line << ",\"spec\":\"" << json_escape(spec) << "\",\"error\":\""
+         << json_escape(problem.status().ToString()) << "\"}" << std::endl;
+      continue;
+    }
+    const Tabulator* table = get_table(series, *problem);
+    BatchJob job{line, spec, *problem, table};
+    if (single_pass) groups[std::make_pair(series, problem->size())].push_back(job);
+    else enqueue(std::vector<BatchJob>(1, job));
+  }
+  for (auto& [key, jobs] : groups) enqueue(std::move(jobs));
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    done = true;
+  }
+  queue_cv.notify_all();
+  for (auto& worker : workers) worker.join();
+  return count;
+}
+
+}
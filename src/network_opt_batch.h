@@ -0,0 +1,45 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _NETWORK_OPT_BATCH_H_
+#define _NETWORK_OPT_BATCH_H_
+
+#include "network_opt.h"
+#include <map>
+#include <mutex>
+
+namespace network_opt {
+
+// Solves a stream of "<series> <n> <target>" specifications, one per line,
+// with the exact solver.  Each (series, n) pair is tabulated once and the
+// table is shared by all worker threads; one JSON object is written per
+// specification as soon as it is solved (so not necessarily in input order).
+// With single_pass, the whole input is read first, and the specifications of
+// each (series, n) pair are solved together by one MultiSolver.
+struct BatchSolver {
+  BatchSolver(const Params& params, unsigned int threads, bool single_pass = false);
+  ~BatchSolver();
+  // Returns the number of specifications that were read.
+  unsigned int solve(std::istream& is, std::ostream& os);
+
+ private:
+  Params params; unsigned int threads; bool single_pass;
+  std::map<std::pair<std::string, unsigned int>, Tabulator*> tables;
+  std::mutex output_mutex;
+
+  const Tabulator* get_table(const std::string& series, const Problem& problem);
+};
+
+}
+
+#endif
@@ -0,0 +1,153 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "network_opt_cache.h"
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace network_opt {
+
+const char CACHE_MAGIC[] = "network_opt-cache-1";
+
+// FNV-1a, which unlike std::hash is the same on every platform and build.
+static uint64_t stable_hash(const std::string& s) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (unsigned char c : s) hash = (hash ^ c) * 0x100000001b3ull;
+  return hash;
+}
+
+static std::string problem_spec(const Problem& problem) {
+  std::ostringstream os;
+  os << "square=" << problem.square << " kind=" << problem.kind << " inventory=" << problem.inventory << "/"
+     << problem.max_parts << " target=" << problem.target << " elements=";
+  for (auto& element : problem.elements) os << element << ",";
+  return os.str();
+}
+
+// Of the networks that are proven optimal for the problem.
+static uint64_t optimum_key(const Problem& problem) {
+  return stable_hash("optimum " + problem_spec(problem));
+}
+
+// Of the networks found by a search whose time limit is not part of the key.
+static uint64_t search_key(const Problem& problem, const std::string& method, const Params& params) {
+  std::ostringstream os;
+  os << "search " << problem_spec(problem) << " method=" << method << " b=" << params.b << " m=" << params.m
+     << " k=" << params.k << " tolerance=" << params.tolerance << " max_cost=" << params.max_cost;
+  return stable_hash(os.str());
+}
+
+static void write_solution(std::ostream& os, uint64_t key, const CachedSolution& solution) {
+  os << std::hex << std::setw(16) << std::setfill('0') << key << std::dec << std::setprecision(17) << " "
+     << solution.optimal << " " << solution.budget << " " << solution.cost << " " << solution.network << "\n";
+}
+
+// Whether a search with a time limit of budget (0 for none) searches at
+// least as long as one with a limit of other.
+static bool covers(double budget, double other) {
+  return !budget || (other && budget >= other);
+}
+
+absl::StatusOr<std::unique_ptr<SolutionCache>> SolutionCache::open(const std::string& path) {
+  std::unique_ptr<SolutionCache> cache(new SolutionCache(path));
+  if (path.empty()) return cache;
+  std::ifstream file(path);
+  if (!file) {
+    std::ofstream created(path);
+    created << CACHE_MAGIC << std::endl;
+    if (!created) return absl::UnavailableError("cannot write " + path);
+    return cache;
+  }
+  std::string header;
+  std::getline(file, header);
+  if (header != CACHE_MAGIC) return absl::InvalidArgumentError(path + " is not a solution cache");
+  unsigned int lines = 0;
+  for (std::string line; std::getline(file, line); ++lines) {
+    std::istringstream is(line);
+    uint64_t key;
+    std::string cost;
+    CachedSolution solution;
+    if (!(is >> std::hex >> key >> std::dec >> solution.optimal >> solution.budget >> cost >> solution.network) ||
+        !parse_ratio(cost, &solution.cost)) {
+      return absl::InvalidArgumentError("corrupt solution cache: " + path);
+    }
+    std::unique_ptr<Node> network(Node::parse(solution.network));
+    if (!network) return absl::InvalidArgumentError("corrupt solution cache: " + path);
+    cache->keep(key, solution);
+  }
+  if (lines <= 2 * cache->solutions.size()) return cache;
+  std::string temporary = path + ".tmp";
+  std::ofstream compacted(temporary);
+  compacted << CACHE_MAGIC << std::endl;
+  for (auto& [key, solution] : cache->solutions) write_solution(compacted, key, solution);
+  compacted.close();
+  if (!compacted || std::rename(temporary.c_str(), path.c_str()) != 0)
+    return absl::UnavailableError("cannot write " + path);
+  return cache;
+}
+
+bool SolutionCache::keep(uint64_t key, const CachedSolution& solution) {
+  auto it = solutions.find(key);
+  if (it != solutions.end()) {
+    const CachedSolution& kept = it->second;
+    // An optimum is never superseded, and otherwise a longer search wins
+    // over a shorter one, and a cheaper network over one found as long.
+    if (kept.optimal) return false;
+    bool longer = covers(solution.budget, kept.budget), shorter = covers(kept.budget, solution.budget);
+    if (!longer || (shorter && kept.cost <= solution.cost)) return false;
+  }
+  solutions[key] = solution;
+  return true;
+}
+
+bool SolutionCache::lookup(const Problem& problem, const std::string& method, const Params& params,
+                           CachedSolution* solution) {
+  if (params.shards > 1) return false;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = solutions.find(optimum_key(problem));
+  // A search that keeps nothing above max_cost finds no network if the optimum costs more.
+  if (it != solutions.end() && params.max_cost >= 0 && it->second.cost > params.max_cost) it = solutions.end();
+  if (it == solutions.end()) {
+    it = solutions.find(search_key(problem, method, params));
+    if (it == solutions.end() || !covers(it->second.budget, params.time_limit)) return false;
+  }
+  *solution = it->second;
+  return true;
+}
+
+absl::Status SolutionCache::insert(const Problem& problem, const std::string& method, const Params& params,
+                                   const Node* network, bool optimal) {
+  if (!network || params.shards > 1) return absl::OkStatus();
+  CachedSolution solution;
+  solution.network = network->to_network();
+  solution.cost = NetworkEvaluator().evaluate_cost(problem, network);
+  solution.optimal = optimal;
+  solution.budget = optimal ? 0 : params.time_limit;
+  uint64_t key = optimal ? optimum_key(problem) : search_key(problem, method, params);
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!keep(key, solution) || path.empty()) return absl::OkStatus();
+  std::ofstream file(path, std::ios::app);
+  write_solution(file, key, solution);
+  file.close();
+  if (!file) return absl::UnavailableError("cannot write " + path);
+  return absl::OkStatus();
+}
+
+size_t SolutionCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return solutions.size();
+}
+
+}
@@ -0,0 +1,66 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#ifndef _NETWORK_OPT_CACHE_H_
+#define _NETWORK_OPT_CACHE_H_
+
+#include "network_opt.h"
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace network_opt {
+
+// A network remembered by a SolutionCache.
+struct CachedSolution {
+  std::string network;  // As printed by Node::to_network().
+  Ratio cost = -1;
+  bool optimal = false;  // Proven optimal, so it answers any later search of the problem.
+  double budget = 0;     // The time limit of the search that found it, or 0 for none.
+};
+
+// Remembers the best networks found for problems, keyed by 64-bit hashes of
+// their canonical specifications: the elements, target, square, kind and
+// inventory of the problem, plus, for networks that are not proven optimal,
+// the method (such as "LOCAL") and the params that shape its search.  A
+// proven optimum answers every later search of its problem, while any other
+// network only answers searches by the same method and params whose time
+// limit is at most the one it was found with.  Only the best network is
+// kept, and sharded searches are neither answered nor remembered.
+//
+// Solutions are kept in memory and, if the cache has a path, appended to
+// that file as one line each, which open() reads back (rewriting the file
+// if most of its lines have been superseded).  Methods are thread-safe.
+struct SolutionCache {
+  static absl::StatusOr<std::unique_ptr<SolutionCache>> open(const std::string& path);
+  // Returns whether a remembered network is as good as a search of the
+  // problem by method with params would find, and sets *solution to it.
+  // It is never one that costs more than params.max_cost (if set).
+  bool lookup(const Problem& problem, const std::string& method, const Params& params, CachedSolution* solution);
+  // Remembers the outcome of a search unless a cached network at least as
+  // good is already remembered for it.
+  absl::Status insert(const Problem& problem, const std::string& method, const Params& params,
+                      const Node* network, bool optimal);
+  size_t size() const;
+
+ private:
+  std::string path; std::unordered_map<uint64_t, CachedSolution> solutions; mutable std::mutex mutex;
+  SolutionCache(const std::string& _path) : path(_path) {}
+  // Returns whether solution was kept in place of any solution under key.
+  bool keep(uint64_t key, const CachedSolution& solution);
+};
+
+}
+
+#endif
@@ -0,0 +1,110 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Benchmark client for "network_opt SERVE <socket>": replays the queries in
+// a file over several connections (each with one query in flight) and
+// reports throughput and latency percentiles.
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+ABSL_FLAG(unsigned int, connections, 4, "Number of concurrent connections.");
+ABSL_FLAG(unsigned int, repeat, 1, "Number of times each query is sent.");
+
+int connect_to(const std::string& path) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd >= 0 && connect(fd, (sockaddr*) &address, sizeof(address)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+  if (args.size() != 3) {
+    std::cerr << "Usage: network_opt_client <socket> <queries>" << std::endl;
+    return 1;
+  }
+  std::vector<std::string> queries;
+  std::ifstream file(args[2]);
+  for (std::string line; std::getline(file, line); ) if (!line.empty()) queries.push_back(line);
+  for (unsigned int r = 1, size = queries.size(); r < absl::GetFlag(FLAGS_repeat); ++r)
+    for (unsigned int i = 0; i < size; ++i) queries.push_back(queries[i]);
+  if (queries.empty()) {
+    std::cerr << "No queries in " << args[2] << std::endl;
+    return 1;
+  }
+  std::vector<double> latencies;
+  std::mutex mutex;
+  unsigned int next = 0, errors = 0;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (unsigned int c = 0; c < absl::GetFlag(FLAGS_connections); ++c) {
+    threads.emplace_back([&]() {
+      int fd = connect_to(args[1]);
+      if (fd < 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::cerr << "Cannot connect to " << args[1] << std::endl;
+        return;
+      }
+      std::string buffer;
+      while (true) {
+        std::string query;
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (next == queries.size()) break;
+          query = queries[next++] + "\n";
+        }
+        auto sent = std::chrono::steady_clock::now();
+        if (send(fd, query.data(), query.size(), MSG_NOSIGNAL) != (ssize_t) query.size()) break;
+        size_t end;
+        char chunk[4096];
+        ssize_t n = 1;
+        while ((end = buffer.find('\n')) == std::string::npos && (n = recv(fd, chunk, sizeof(chunk), 0)) > 0)
+          buffer.append(chunk, n);
+        if (n <= 0) break;
+        std::chrono::duration<double> latency = std::chrono::steady_clock::now() - sent;
+        std::lock_guard<std::mutex> lock(mutex);
+        latencies.push_back(latency.count());
+        if (buffer.substr(0, end).find("\"error\":") != std::string::npos) ++errors;
+        buffer.erase(0, end + 1);
+      }
+      close(fd);
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  if (latencies.empty()) return 1;
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p) { return 1000 * latencies[std::min<size_t>(latencies.size() - 1, p * latencies.size())]; };
+  std::cout << "   Queries: " << latencies.size() << " (" << errors << " errors)" << std::endl;
+  std::cout << "Throughput: " << latencies.size() / elapsed.count() << " queries/second" << std::endl;
+  std::cout << "   Latency: p50 " << percentile(0.5) << " ms, p90 " << percentile(0.9) << " ms, p99 "
+            << percentile(0.99) << " ms, max " << 1000 * latencies.back() << " ms" << std::endl;
+}
@@ -0,0 +1,272 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "network_opt_evolve.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace network_opt {
+
+EvolutionSolver::EvolutionSolver(const Params& _params, const EvolutionParams& _evolution)
+    : params(_params), evolution(_evolution), tabulator(NULL), table(NULL), top(_params.k), trace(NULL),
+      generations(0) {
+  if (params.m) table = tabulator = new Tabulator(params.m);
+}
+
+EvolutionSolver::EvolutionSolver(const Params& _params, const Tabulator* shared_tabulator,
+                                 const EvolutionParams& _evolution)
+    : params(_params), evolution(_evolution), tabulator(NULL), table(shared_tabulator), top(_params.k),
+      trace(NULL), generations(0) {}
+
+EvolutionSolver::~EvolutionSolver() {
+  if (tabulator) delete tabulator;
+}
+
+static bool is_expandable(const Node* node) { return !node->hidden.empty(); }
+
+// Copies an individual, sharing the table entries of its expandables.
+static Node* copy_individual(const Node* node) {
+  if (node->ratio) return const_cast<Node*>(node);
+  Node* copy = &N(node->values);
+  copy->hidden = node->hidden;
+  for (auto child : node->children) copy->children.push_back(copy_individual(child));
+  return copy;
+}
+
+// Appends the nodes of an individual down to its expandables, in preorder,
+// each with its parent (NULL for the root).
+static void collect(Node* node, Node* parent, std::vector<std::pair<Node*, Node*>>& nodes) {
+  nodes.push_back({node, parent});
+  if (is_expandable(node)) return;
+  for (auto child : node->children) collect(child, node, nodes);
+}
+
+static void collect_expandables(Node* node, std::vector<Node*>& expandables) {
+  if (is_expandable(node)) {
+    expandables.push_back(node);
+    return;
+  }
+  for (auto child : node->children) collect_expandables(child, expandables);
+}
+
+static Mask hidden_elements(const Node* node) {
+  Mask mask = 0;
+  for (auto value : node->hidden) mask |= 1 << value;
+  if (!is_expandable(node)) for (auto child : node->children) mask |= hidden_elements(child);
+  return mask;
+}
+
+// Gives an expandable a random entry of the table for its elements.
+static void draw(const Tabulator* table, Node* expandable, std::mt19937& rng) {
+  const std::vector<std::pair<Ratio, Node*>>& entry = table->lookup_table[SubsetCoder().encode(expandable->hidden)];
+  expandable->children.clear();
+  expandable->children.push_back(entry[rng() % entry.size()].second);
+}
+
+// Removes the nodes below node that no longer hold any element.
+static void remove_empty(Node* node) {
+  for (auto it = node->children.begin(); it != node->children.end(); ) {
+    Node* child = *it;
+    if (child->ratio || is_expandable(child)) { ++it; continue; }
+    remove_empty(child);
+    if (child->children.empty()) {
+      delete child;
+      it = node->children.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+// Adds value to a random expandable with room for it, or else to a new
+// expandable under a random inner node.  Returns the (possibly new) root.
+static Node* add_element(const Tabulator* table, Node* network, Value value, std::mt19937& rng) {
+  std::vector<std::pair<Node*, Node*>> nodes;
+  collect(network, NULL, nodes);
+  std::vector<Node*> roomy, inner;
+  for (auto [node, parent] : nodes) {
+    if (!is_expandable(node)) inner.push_back(node);
+    else if (node->hidden.size() < table->m) roomy.push_back(node);
+  }
+  Node* expandable;
+  if (!roomy.empty() && rng() % 2) {
+    expandable = roomy[rng() % roomy.size()];
+  } else {
+    if (inner.empty()) {
+      network = &(N()[*network]);
+      inner.push_back(network);
+    }
+    expandable = &N();
+    inner[rng() % inner.size()]->children.push_back(expandable);
+  }
+  expandable->hidden.push_back(value);
+  draw(table, expandable, rng);
+  return network;
+}
+
+// Replaces a random subtree of network with a copy of a random subtree of
+// donor, then restores every element to exactly one expandable: those that
+// the graft brought in are removed from the rest of the network, and those
+// that it displaced are added back.  Returns the (possibly new) root.
+static Node* graft(const Tabulator* table, Node* network, const Node* donor, std::mt19937& rng) {
+  std::vector<std::pair<Node*, Node*>> nodes, donors;
+  collect(network, NULL, nodes);
+  collect(const_cast<Node*>(donor), NULL, donors);
+  if (nodes.size() < 2) return network;
+  auto [replaced, parent] = nodes[1 + rng() % (nodes.size() - 1)];
+  Node* scion = copy_individual(donors[rng() % donors.size()].first);
+  Mask displaced = hidden_elements(replaced), brought = hidden_elements(scion);
+  std::replace(parent->children.begin(), parent->children.end(), replaced, scion);
+  delete replaced;
+  std::vector<Node*> expandables, grafted;
+  collect_expandables(network, expandables);
+  collect_expandables(scion, grafted);
+  for (Node* expandable : expandables) {
+    if (std::find(grafted.begin(), grafted.end(), expandable) != grafted.end()) continue;
+    Mask duplicates = hidden_elements(expandable) & brought & ~displaced;
+    if (!duplicates) continue;
+    expandable->hidden.remove_if([&](Value value) { return duplicates >> value & 1; });
+    if (is_expandable(expandable)) draw(table, expandable, rng);
+    else expandable->children.clear();
+  }
+  remove_empty(network);
+  for (Mask missing = displaced & ~brought; missing; missing &= missing - 1)
+    network = add_element(table, network, __builtin_ctz(missing), rng);
+  return network;
+}
+
+// Re-draws the entry of a random expandable, or moves one of its elements
+// to another expandable.  Returns the (possibly new) root.
+static Node* mutate(const Tabulator* table, Node* network, std::mt19937& rng) {
+  std::vector<Node*> expandables;
+  collect_expandables(network, expandables);
+  Node* expandable = expandables[rng() % expandables.size()];
+  if (rng() % 2 || expandables.size() < 2) {
+    draw(table, expandable, rng);
+    return network;
+  }
+  auto it = expandable->hidden.begin();
+  std::advance(it, rng() % expandable->hidden.size());
+  Value value = *it;
+  expandable->hidden.erase(it);
+  if (is_expandable(expandable)) draw(table, expandable, rng);
+  else expandable->children.clear();
+  remove_empty(network);
+  return add_element(table, network, value, rng);
+}
+
+std::vector<EvolutionSolver::Individual> EvolutionSolver::breed(const Problem& problem,
+                                                                const std::vector<Birth>& births) {
+  std::vector<Individual> individuals(births.size());
+  std::vector<Stats> birth_stats(births.size());
+  std::atomic<unsigned int> next(0);
+  auto work = [&]() {
+    NetworkEvaluator evaluator;
+    for (unsigned int i; (i = next++) < births.size(); ) {
+      const Birth& birth = births[i];
+      std::mt19937 rng(birth.seed);
+      Node* network;
+      if (!birth.parent_a) {
+        std::vector<Value> values;
+        for (Value v = 0; v < problem.size(); ++v) values.push_back(v);
+        std::shuffle(values.begin(), values.end(), rng);
+        network = &N();
+        for (auto value : values) network->values.push_back(value);
+        std::vector<Node*> expandables;
+        randomly_expand(table, network, rng, expandables);
+      } else {
+        network = copy_individual(birth.parent_a);
+        if (birth.parent_b) network = graft(table, network, birth.parent_b, rng);
+        network = mutate(table, network, rng);
+      }
+      std::vector<Node*> expandables;
+      collect_expandables(network, expandables);
+      iteratively_improve(problem, table, network, expandables, rng, birth_stats[i], params.cancel);
+      STAT(++birth_stats[i].leaves; ++birth_stats[i].evaluations);
+      individuals[i] = {network, evaluator.evaluate_cost(problem, network)};
+    }
+  };
+  std::vector<std::thread> workers;
+  for (unsigned int i = 1; i < evolution.threads; ++i) workers.emplace_back(work);
+  work();
+  for (auto& worker : workers) worker.join();
+  for (auto& s : birth_stats) {
+    STAT(stats.nodes += s.nodes; stats.leaves += s.leaves; stats.binary_searches += s.binary_searches;
+         stats.linear_searches += s.linear_searches; stats.probes += s.probes; stats.evaluations += s.evaluations);
+  }
+  return individuals;
+}
+
+Node* EvolutionSolver::solve(const Problem& problem) {
+  auto start = std::chrono::steady_clock::now();
+  top.clear();
+  Deadline deadline(params.time_limit, 1, params.cancel);
+  stats = Stats();
+  generations = 0;
+  if (tabulator) tabulator->tabulate(problem);
+  STAT(if (tabulator) stats = tabulator->stats);
+  STAT(auto search_start = std::chrono::steady_clock::now());
+  std::mt19937_64 rng(evolution.seed);
+  unsigned int size = std::max(evolution.population, 2u);
+  std::vector<Birth> births;
+  for (unsigned int i = 0; i < size; ++i) births.push_back({rng(), NULL, NULL});
+  std::vector<Individual> population = breed(problem, births);
+  while (true) {
+    std::stable_sort(population.begin(), population.end(),
+                     [](const Individual& i1, const Individual& i2) { return i1.cost < i2.cost; });
+    // Individuals of equal cost are most likely the same network, so only
+    // the first of each cost survives.
+    std::vector<Individual> survivors;
+    for (auto& individual : population) {
+      if (survivors.size() < size && (survivors.empty() || survivors.back().cost < individual.cost)) {
+        survivors.push_back(individual);
+      } else {
+        delete individual.network;
+      }
+    }
+    population = std::move(survivors);
+    Ratio best = top.empty() ? Ratio(-1) : top.best()->ratio;
+    for (auto& individual : population) top.offer(problem, individual.network, individual.cost);
+    if ((trace || observer) && (best < 0 || top.best()->ratio < best)) {
+      double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      if (trace) print_trace(*trace, seconds, top.best(), stats);
+      if (observer) observer(seconds, top.best());
+    }
+    if ((evolution.generations && generations >= evolution.generations) || deadline.expired() ||
+        (top.full() && top.cutoff() <= params.tolerance)) break;
+    ++generations;
+    // Tournaments of two pick the parents of all but an eighth of the
+    // births, which are newcomers.
+    births.clear();
+    auto tournament = [&]() {
+      const Individual& i1 = population[rng() % population.size()];
+      const Individual& i2 = population[rng() % population.size()];
+      return (i1.cost <= i2.cost) ? i1.network : i2.network;
+    };
+    for (unsigned int i = 0; i < size; ++i) {
+      uint64_t seed = rng();
+      if (i >= size - size / 8) { births.push_back({seed, NULL, NULL}); continue; }
+      const Node* parent_a = tournament();
+      const Node* parent_b = (rng() % 10) ? tournament() : NULL;
+      births.push_back({seed, parent_a, parent_b});
+    }
+    std::vector<Individual> offspring = breed(problem, births);
+    population.insert(population.end(), offspring.begin(), offspring.end());
+  }
+  for (auto& individual : population) delete individual.network;
+  STAT(stats.search_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - search_start).count());
+  return top.best();
+}
+
+}
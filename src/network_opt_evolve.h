@@ -0,0 +1,70 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _NETWORK_OPT_EVOLVE_H_
+#define _NETWORK_OPT_EVOLVE_H_
+
+#include "network_opt_local.h"
+
+namespace network_opt {
+
+struct EvolutionParams {
+  unsigned int population = 32;
+  unsigned int generations = 0;  // Zero for no limit but params.time_limit and params.tolerance.
+  unsigned int threads = 1;      // Results do not depend on it.
+  unsigned int seed = 2022;
+};
+
+// A memetic algorithm over the networks that LocalSolver restarts from:
+// series-parallel trees whose leaves are expandables of at most params.m
+// elements, each holding an entry of the table.  Each generation breeds an
+// offspring per individual from two parents chosen by tournament, grafting
+// a random subtree of one into the other and repairing the expandables so
+// that every element is used exactly once, then mutates it (re-drawing an
+// entry, or moving an element between expandables) and improves it with
+// iteratively_improve().  A few random newcomers join each generation, and
+// the best individuals of distinct costs survive.  Offspring are bred and
+// evaluated on evolution.threads threads, each from its own seed, so the
+// search does not depend on the number of threads.
+struct EvolutionSolver {
+  EvolutionSolver(const Params& params, const EvolutionParams& evolution = EvolutionParams());
+  // Searches with a table that the caller has already tabulated.
+  EvolutionSolver(const Params& params, const Tabulator* shared_tabulator,
+                  const EvolutionParams& evolution = EvolutionParams());
+  ~EvolutionSolver();
+  // Evolves until evolution.generations, params.time_limit or params.cancel
+  // (checked after every generation) or params.tolerance stops it; at least
+  // one of them must be set.
+  Node* solve(const Problem& problem);
+  // The params.k best distinct networks found by the last solve(), best first.
+  const std::vector<Node*>& solutions() const { return top.all(); }
+  const Stats& get_stats() const { return stats; }
+  const Tabulator* get_table() const { return table; }
+  unsigned int get_generations() const { return generations; }
+  // Writes a JSON line to os (if not NULL) for every new best network.
+  void set_trace(std::ostream* os) { trace = os; }
+  void set_observer(const IncumbentObserver& _observer) { observer = _observer; }
+
+ private:
+  struct Individual { Node* network; Ratio cost; };
+  Params params; EvolutionParams evolution; Tabulator* tabulator; const Tabulator* table; TopNetworks top;
+  std::ostream* trace; IncumbentObserver observer; Stats stats; unsigned int generations;
+  // A newcomer to breed if parent_a is NULL, and otherwise the offspring of
+  // parent_a, grafted with a subtree of parent_b unless that is NULL.
+  struct Birth { uint64_t seed; const Node* parent_a; const Node* parent_b; };
+  std::vector<Individual> breed(const Problem& problem, const std::vector<Birth>& births);
+};
+
+}
+
+#endif
@@ -0,0 +1,276 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "network_opt_index.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace network_opt {
+
+const char INDEX_MAGIC[8] = "NETIDX1";
+
+struct ResistanceIndex::Header {
+  char magic[8]; uint32_t n; uint32_t complete; uint64_t fingerprint; uint64_t count;
+};
+
+struct ResistanceIndex::Record {
+  double total; uint64_t offset; uint32_t length; uint32_t unused;
+};
+
+// A total of some subset, along with how it was obtained: either a table
+// entry, or two totals of complementary subsets combined by op.
+template <typename Total>
+struct IndexTotal {
+  Total total; char op; Mask a; unsigned int i, j; Node* node;
+};
+
+static uint64_t fingerprint(const Problem& problem) {
+  std::ostringstream os;
+  for (auto& element : problem.elements) os << element << ",";
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : os.str()) hash = (hash ^ (unsigned char) c) * 1099511628211ull;
+  return hash;
+}
+
+// Returns a node expressing the given total as a child of a node whose
+// operator is parent_op.
+template <typename Total>
+static Node* express(const std::vector<std::vector<IndexTotal<Total>>>& totals, Mask mask, unsigned int idx,
+                     char parent_op) {
+  const IndexTotal<Total>& t = totals[mask][idx];
+  if (t.node) return t.node;
+  char op = (parent_op == '+') ? '|' : '+';
+  if (t.op == op) {
+    return &N()[*express(totals, t.a, t.i, op)][*express(totals, mask ^ t.a, t.j, op)];
+  }
+  return &N()[N()[*express(totals, t.a, t.i, parent_op)][*express(totals, mask ^ t.a, t.j, parent_op)]];
+}
+
+// Calls visit(total, op, a, i, j) for every combination of two totals of
+// complementary subsets of mask, or visit(total, 0, 0, 0, 0, node) for
+// every table entry if mask is small enough.
+template <typename Total, typename Visit>
+static void combine(const Tabulator& tabulator, const std::vector<std::vector<IndexTotal<Total>>>& totals,
+                    Mask mask, Visit visit) {
+  if (std::popcount(mask) <= (int) tabulator.m) {
+    for (auto& [ratio, node] : tabulator.lookup_table[mask]) {
+      if constexpr (std::is_same_v<Total, Ratio>) visit(ratio, 0, 0, 0, 0, node);
+      else visit(boost::rational_cast<Total>(ratio), 0, 0, 0, 0, node);
+    }
+    return;
+  }
+  Mask low = mask & -mask;
+  for (Mask a = (mask - 1) & mask; a; a = (a - 1) & mask) {
+    if (!(a & low)) continue;
+    const std::vector<IndexTotal<Total>>& set_a = totals[a], & set_b = totals[mask ^ a];
+    for (unsigned int i = 0; i < set_a.size(); ++i) {
+      for (unsigned int j = 0; j < set_b.size(); ++j) {
+        const Total& x = set_a[i].total, & y = set_b[j].total;
+        visit(x + y, '+', a, i, j, NULL);
+        visit(x * y / (x + y), '|', a, i, j, NULL);
+      }
+    }
+  }
+}
+
+// Keeps every distinct total of every subset, exactly.
+static void tabulate_all(const Tabulator& tabulator, std::vector<std::vector<IndexTotal<Ratio>>>& totals) {
+  for (Mask mask = 1; mask < totals.size(); ++mask) {
+    std::vector<IndexTotal<Ratio>>& set = totals[mask];
+    combine<Ratio>(tabulator, totals, mask, [&](const Ratio& total, char op, Mask a, unsigned int i,
+                                                unsigned int j, Node* node) {
+      set.push_back({total, op, a, i, j, node});
+    });
+    auto by_total = [](const auto& x, const auto& y) { return x.total < y.total; };
+    std::stable_sort(set.begin(), set.end(), by_total);
+    set.erase(std::unique(set.begin(), set.end(), [](const auto& x, const auto& y) {
+      return x.total == y.total; }), set.end());
+  }
+}
+
+// Keeps at most limit totals of every proper subset, one per bucket of a
+// geometric partition of the range between its all-parallel and all-series
+// totals, and every distinct combination of those for the full set.
+// Floating point is accurate enough to choose witnesses, whose exact totals
+// are evaluated when queried, and avoids the cost of big rationals.
+static void tabulate_some(const Problem& problem, const Tabulator& tabulator, unsigned int limit,
+                          std::vector<std::vector<IndexTotal<double>>>& totals) {
+  std::vector<IndexTotal<double>> buckets(limit);
+  for (Mask mask = 1; mask < totals.size(); ++mask) {
+    double series = 0, parallel = 0;
+    for (unsigned int k = 0; k < problem.size(); ++k) {
+      if (!(mask & (1 << k))) continue;
+      double element = boost::rational_cast<double>(problem.elements[k]);
+      series += element;
+      parallel += 1 / element;
+    }
+    double lo = std::log(1 / parallel), scale = limit / std::max(std::log(series) - lo, 1e-12);
+    std::vector<IndexTotal<double>>& set = totals[mask];
+    if (mask == totals.size() - 1) {
+      combine<double>(tabulator, totals, mask, [&](double total, char op, Mask a, unsigned int i,
+                                                   unsigned int j, Node* node) {
+        set.push_back({total, op, a, i, j, node});
+      });
+      std::stable_sort(set.begin(), set.end(), [](const auto& x, const auto& y) { return x.total < y.total; });
+      set.erase(std::unique(set.begin(), set.end(), [](const auto& x, const auto& y) {
+        return x.total == y.total; }), set.end());
+      break;
+    }
+    for (auto& bucket : buckets) bucket.op = -1;
+    combine<double>(tabulator, totals, mask, [&](double total, char op, Mask a, unsigned int i,
+                                                 unsigned int j, Node* node) {
+      int k = std::clamp((int) ((std::log(total) - lo) * scale), 0, (int) limit - 1);
+      if (buckets[k].op == -1) buckets[k] = {total, op, a, i, j, node};
+    });
+    for (auto& bucket : buckets)
+      if (bucket.op != -1) set.push_back(bucket);
+  }
+}
+
+// Returns each total of the full set, rounded, with its witness network.
+template <typename Total>
+static std::vector<std::pair<double, std::string>> witnesses(
+    const std::vector<std::vector<IndexTotal<Total>>>& totals) {
+  Mask full = totals.size() - 1;
+  std::vector<std::pair<double, std::string>> result;
+  for (unsigned int idx = 0; idx < totals[full].size(); ++idx) {
+    Node* network = &N();
+    const IndexTotal<Total>& t = totals[full][idx];
+    if (t.node || t.op == '|') network->children.push_back(express(totals, full, idx, '+'));
+    else (*network)[*express(totals, t.a, t.i, '+')][*express(totals, full ^ t.a, t.j, '+')];
+    if constexpr (std::is_same_v<Total, Ratio>) result.emplace_back(boost::rational_cast<double>(t.total), "");
+    else result.emplace_back(t.total, "");
+    result.back().second = network->to_network();
+    delete network;
+  }
+  return result;
+}
+
+absl::Status ResistanceIndex::build(const Problem& problem, unsigned int m, unsigned int limit,
+                                    const std::string& path) {
+  unsigned int n = problem.size();
+  if (m < 1 || m > n) return absl::InvalidArgumentError("m must be in [1, n]");
+  if (limit == 1) return absl::InvalidArgumentError("limit must be zero or at least two");
+  Tabulator tabulator(m);
+  tabulator.tabulate(problem);
+  std::vector<std::pair<double, std::string>> entries;
+  if (limit) {
+    std::vector<std::vector<IndexTotal<double>>> totals(1 << n);
+    tabulate_some(problem, tabulator, limit, totals);
+    entries = witnesses(totals);
+  } else {
+    std::vector<std::vector<IndexTotal<Ratio>>> totals(1 << n);
+    tabulate_all(tabulator, totals);
+    entries = witnesses(totals);
+  }
+  std::string blob;
+  std::vector<Record> records;
+  for (auto& [total, network] : entries) {
+    records.push_back({total, blob.size(), (uint32_t) network.size(), 0});
+    blob += network;
+  }
+  Header header = {};
+  memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+  header.n = n;
+  header.complete = !limit;
+  header.fingerprint = fingerprint(problem);
+  header.count = records.size();
+  std::ofstream file(path, std::ios::binary);
+  file.write((const char*) &header, sizeof(header));
+  file.write((const char*) records.data(), records.size() * sizeof(Record));
+  file.write(blob.data(), blob.size());
+  if (!file) return absl::UnavailableError("cannot write " + path);
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::unique_ptr<ResistanceIndex>> ResistanceIndex::open(const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return absl::ErrnoToStatus(errno, path);
+  struct stat st;
+  if (fstat(fd, &st) < 0) { close(fd); return absl::ErrnoToStatus(errno, path); }
+  size_t bytes = st.st_size;
+  void* data = (bytes >= sizeof(Header)) ? mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (data == MAP_FAILED) return absl::InvalidArgumentError("cannot map " + path);
+  std::unique_ptr<ResistanceIndex> index(new ResistanceIndex((const char*) data, bytes));
+  const Header& header = index->header();
+  if (memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+      header.count > (bytes - sizeof(Header)) / sizeof(Record))
+    return absl::InvalidArgumentError("not a resistance index: " + path);
+  for (unsigned long long idx = 0; idx < header.count; ++idx) {
+    const Record& record = index->records()[idx];
+    if (record.offset + record.length > bytes - sizeof(Header) - header.count * sizeof(Record))
+      return absl::InvalidArgumentError("corrupt resistance index: " + path);
+  }
+  return index;
+}
+
+ResistanceIndex::~ResistanceIndex() { munmap((void*) data, bytes); }
+
+const ResistanceIndex::Header& ResistanceIndex::header() const { return *(const Header*) data; }
+
+const ResistanceIndex::Record* ResistanceIndex::records() const {
+  return (const Record*) (data + sizeof(Header));
+}
+
+unsigned long long ResistanceIndex::size() const { return header().count; }
+
+bool ResistanceIndex::complete() const { return header().complete; }
+
+std::string ResistanceIndex::witness(unsigned long long idx) const {
+  const Record& record = records()[idx];
+  const char* blob = (const char*) (records() + header().count);
+  return std::string(blob + record.offset, record.length);
+}
+
+absl::StatusOr<Node*> ResistanceIndex::nearest(const Problem& problem) const {
+  if (header().n != problem.size() || header().fingerprint != fingerprint(problem))
+    return absl::InvalidArgumentError("the index was built for different elements");
+  if (!size()) return absl::NotFoundError("the index is empty");
+  double target = boost::rational_cast<double>(problem.target);
+  if (problem.square) target = std::sqrt(target);
+  if (problem.kind == Problem::CONDUCTANCE) target = 1 / target;
+  const Record* begin = records(), * end = records() + size();
+  unsigned long long lo = std::lower_bound(begin, end, target, [](const Record& record, double t) {
+    return record.total < t; }) - begin;
+  // Rounding may misplace the target by a record or two, so check around it
+  // with the exact totals of the witnesses.
+  NetworkEvaluator evaluator;
+  Node* best_network = NULL;
+  Ratio best_cost;
+  for (unsigned long long idx = (lo > 2) ? lo - 2 : 0; idx < std::min(lo + 2, size()); ++idx) {
+    Node* network = Node::parse(witness(idx));
+    if (!network) {
+      delete best_network;
+      return absl::InvalidArgumentError("corrupt witness in resistance index");
+    }
+    Ratio cost = problem.get_cost(evaluator.evaluate_total(problem, network));
+    if (cost < 0) cost = -cost;
+    if (!best_network || cost < best_cost) {
+      std::swap(best_network, network);
+      best_cost = cost;
+    }
+    delete network;
+  }
+  return best_network;
+}
+
+}
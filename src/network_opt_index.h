@@ -0,0 +1,57 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _NETWORK_OPT_INDEX_H_
+#define _NETWORK_OPT_INDEX_H_
+
+#include "network_opt.h"
+#include <memory>
+
+namespace network_opt {
+
+// The sorted set of totals achievable with all elements of a problem (its
+// target is irrelevant), with one witness network per total.  The totals of
+// subsets of at most m elements come from a Tabulator, and larger subsets
+// combine the totals of every split into two smaller subsets in series and
+// in parallel.  If limit is non-zero, at most limit totals (spread
+// geometrically over the range) are kept per subset, so the index is partial
+// and its answers are only upper bounds for the exact Solver.
+//
+// The index is saved as a flat file of fixed-size records sorted by their
+// rounded totals, followed by the witness of each record, and is queried
+// through a read-only memory mapping.
+struct ResistanceIndex {
+  static absl::Status build(const Problem& problem, unsigned int m, unsigned int limit, const std::string& path);
+  static absl::StatusOr<std::unique_ptr<ResistanceIndex>> open(const std::string& path);
+  ~ResistanceIndex();
+
+  unsigned long long size() const;
+  bool complete() const;
+  // Returns the network (owned by the caller) whose cost for the problem is
+  // smallest among the indexed totals, or an error if the index was built
+  // for different elements.
+  absl::StatusOr<Node*> nearest(const Problem& problem) const;
+
+ private:
+  struct Header;
+  struct Record;
+  const char* data; size_t bytes;
+  ResistanceIndex(const char* _data, size_t _bytes) : data(_data), bytes(_bytes) {}
+  const Header& header() const;
+  const Record* records() const;
+  std::string witness(unsigned long long idx) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,120 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "network_opt_ladder.h"
+#include <cmath>
+
+namespace network_opt {
+
+// A rung of a ladder: an element, in series ('+') or in parallel ('|') with
+// the rungs inside it.  The op of the innermost rung is unused.
+struct Rung { Value value; char op; };
+
+// Approximates the cost of a ladder of the given resistance.
+struct LadderCost {
+  LadderCost(const Problem& _problem)
+      : problem(_problem), target(boost::rational_cast<double>(_problem.target)) {}
+  double operator()(double total) const {
+    double power = problem.square ? total * total : total;
+    return std::abs((problem.kind == Problem::CONDUCTANCE) ? target - 1 / power : power - target);
+  }
+  // The resistance that the whole ladder has to meet.
+  double resistance() const {
+    double resistance = problem.square ? std::sqrt(target) : target;
+    return (problem.kind == Problem::CONDUCTANCE) ? 1 / resistance : resistance;
+  }
+  const Problem& problem; double target;
+};
+
+// Appends the rung of value to a ladder that still has to meet resistance,
+// which becomes what the rungs inside it have to meet.
+static void add_rung(double element, Value value, double& resistance, std::vector<Rung>& rungs) {
+  if (element <= resistance) {
+    rungs.push_back({value, '+'});
+    resistance -= element;
+  } else {
+    rungs.push_back({value, '|'});
+    resistance = resistance * element / (element - resistance);
+  }
+}
+
+static double ladder_total(const std::vector<double>& elements, const std::vector<Rung>& rungs) {
+  double total = elements[rungs.back().value];
+  for (int i = int(rungs.size()) - 2; i >= 0; --i) {
+    double element = elements[rungs[i].value];
+    total = (rungs[i].op == '+') ? element + total : element * total / (element + total);
+  }
+  return total;
+}
+
+Node* build_ladder(const Problem& problem, LadderOrder order) {
+  std::vector<double> elements;
+  for (unsigned int i = 0; i < problem.size(); ++i) elements.push_back(boost::rational_cast<double>(problem[i]));
+  std::vector<Value> remaining;
+  for (Value i = 0; i < problem.size(); ++i) remaining.push_back(i);
+  std::sort(remaining.begin(), remaining.end(), [&](Value v1, Value v2) { return elements[v1] > elements[v2]; });
+  if (order == LadderOrder::INCREASING) std::reverse(remaining.begin(), remaining.end());
+  LadderCost cost(problem);
+  double resistance = cost.resistance();
+  std::vector<Rung> rungs;
+  while (!remaining.empty()) {
+    unsigned int best = 0;
+    if (order == LadderOrder::GREEDY && remaining.size() > 1) {
+      double best_cost = INFINITY;
+      for (unsigned int i = 0; i < remaining.size(); ++i) {
+        std::vector<Rung> completed = rungs;
+        double rest = resistance;
+        add_rung(elements[remaining[i]], remaining[i], rest, completed);
+        for (unsigned int j = 0; j < remaining.size(); ++j)
+          if (j != i) add_rung(elements[remaining[j]], remaining[j], rest, completed);
+        double completed_cost = cost(ladder_total(elements, completed));
+        if (completed_cost < best_cost) { best_cost = completed_cost; best = i; }
+      }
+    }
+    add_rung(elements[remaining[best]], remaining[best], resistance, rungs);
+    remaining.erase(remaining.begin() + best);
+  }
+  // Consecutive rungs with the same op are terms of one node.
+  Node* network = &N();
+  Node* node = network;
+  char op = '+';
+  for (unsigned int i = 0; i < rungs.size(); ++i) {
+    if (i + 1 < rungs.size() && rungs[i].op != op) {
+      Node* child = &N();
+      node->children.push_back(child);
+      node = child;
+      op = rungs[i].op;
+    }
+    node->values.push_back(rungs[i].value);
+  }
+  spread_values(network);
+  return network;
+}
+
+Node* best_ladder(const Problem& problem) {
+  NetworkEvaluator evaluator;
+  Node* best = NULL;
+  Ratio best_cost;
+  for (LadderOrder order : {LadderOrder::DECREASING, LadderOrder::INCREASING, LadderOrder::GREEDY}) {
+    Node* ladder = build_ladder(problem, order);
+    Ratio cost = evaluator.evaluate_cost(problem, ladder);
+    if (!best || cost < best_cost) {
+      std::swap(best, ladder);
+      best_cost = cost;
+    }
+    delete ladder;
+  }
+  return best;
+}
+
+}
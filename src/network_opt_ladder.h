@@ -0,0 +1,39 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _NETWORK_OPT_LADDER_H_
+#define _NETWORK_OPT_LADDER_H_
+
+#include "network_opt.h"
+
+namespace network_opt {
+
+// Ladders e1 op1 (e2 op2 (e3 ... en)) are the networks of continued
+// fractions of the target: each element goes in series with the rest of
+// the ladder if it is below the resistance still to be met, and in
+// parallel with it otherwise, which leaves the rest a new resistance to
+// meet.  They differ in the order in which they take the elements:
+// decreasing, increasing, or greedily, choosing at each rung the element
+// whose ladder completed in decreasing order comes closest to the target.
+// The choices are made in floating point, so that even the greedy ladder
+// of 16 elements takes well under a millisecond.
+enum class LadderOrder { DECREASING, INCREASING, GREEDY };
+
+// Returns the ladder (owned by the caller) over all the elements of the problem.
+Node* build_ladder(const Problem& problem, LadderOrder order);
+// Returns the ladder (owned by the caller) of the order that costs least.
+Node* best_ladder(const Problem& problem);
+
+}
+
+#endif
@@ -17,96 +17,115 @@ limitations under the License.
 
 namespace network_opt {
 
-LocalSolver::LocalSolver(const Params& params) : bounder(NULL), tabulator(NULL), best_network(NULL) {
+LocalSolver::LocalSolver(const Params& _params, unsigned int seed, std::ostream* _progress)
+    : params(_params), bounder(NULL), tabulator(NULL), table(NULL), top(_params.k), progress(_progress),
+      trace(NULL), rng(seed) {
   if (params.b) bounder = new Bounder();
-  if (params.m) tabulator = new Tabulator(params.m);
+  if (params.m) table = tabulator = new Tabulator(params.m);
 }
+
+LocalSolver::LocalSolver(const Params& _params, const Tabulator* shared_tabulator, unsigned int seed,
+                         std::ostream* _progress)
+    : params(_params), bounder(NULL), tabulator(NULL), table(shared_tabulator), top(_params.k),
+      progress(_progress), trace(NULL), rng(seed) {
+  if (params.b) bounder = new Bounder();
+}
+
 LocalSolver::~LocalSolver() {
-  clear();
   if (tabulator) delete tabulator;
   if (bounder) delete bounder;
 }
 
 Node* LocalSolver::solve(const Problem& problem) {
   auto start = std::chrono::steady_clock::now();
-  clear();
-  Ratio best_cost = 0;
+  top.clear();
+  Deadline deadline(params.time_limit, 1, params.cancel);
+  stats = Stats();
   if (tabulator) tabulator->tabulate(problem);
-  while (true) {
+  STAT(if (tabulator) stats = tabulator->stats);
+  STAT(auto search_start = std::chrono::steady_clock::now());
+  while (top.empty() || !(deadline.expired() || (top.full() && top.cutoff() <= params.tolerance))) {
+    STAT(++stats.restarts);
     expandables.clear();
     std::vector<Value> values;
     for (Value i = 0; i < problem.size(); ++i) values.push_back(i);
-    random_shuffle(values.begin(), values.end());
+    std::shuffle(values.begin(), values.end(), rng);
     Node* network = &N();
     for (auto value : values) network->values.push_back(value);
-    randomly_expand(network);
-    iteratively_improve(problem, network);
-    Ratio cost = network_evaluator.evaluate_cost(problem, network);
-    if (best_network == NULL || best_cost > cost) {
-      clear();
-      best_cost = cost;
-      best_network = network->clone();
+    randomly_expand(table, network, rng, expandables);
+    iteratively_improve(problem, table, network, expandables, rng, stats, params.cancel);
+    STAT(++stats.leaves; ++stats.evaluations);
+    Ratio cost = evaluator.evaluate_cost(problem, network);
+    bool improved = top.empty() || top.best()->ratio > cost;
+    if (top.offer(problem, network, cost) && improved) {
       auto end = std::chrono::steady_clock::now();
-      auto duration = std::chrono::duration_cast<std::chrono::seconds>(end - start);
-      std::cout << "Found after " << duration.count() << " seconds: " << std::endl;
-      print_summary(std::cout, problem, best_network, "");
-      std::cout << std::endl;
+      if (trace) print_trace(*trace, std::chrono::duration<double>(end - start).count(), top.best(), stats);
+      if (observer) observer(std::chrono::duration<double>(end - start).count(), top.best());
+      if (progress) {
+        auto duration = std::chrono::duration_cast<std::chrono::seconds>(end - start);
+        *progress << "Found after " << duration.count() << " seconds: " << std::endl;
+        print_summary(*progress, problem, top.best(), "");
+        *progress << std::endl;
+      }
     }
     delete network;
   }
-  return best_network;
-}
-
-void LocalSolver::clear() {
-  if (best_network) delete best_network;
-  best_network = NULL;
+  STAT(stats.search_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - search_start).count());
+  return top.best();
 }
 
-void LocalSolver::randomly_expand(Node* node) {
-  if (node->values.size() <= tabulator->m) {
+void randomly_expand(const Tabulator* table, Node* node, std::mt19937& rng, std::vector<Node*>& expandables) {
+  if (node->values.size() <= table->m) {
     expandables.push_back(node);
     node->hidden = node->values;
     node->values.clear();
-    Mask mask = coder.encode(node->hidden);
-    std::vector<std::pair<Ratio, Node*>>& entry = tabulator->lookup_table[mask];
-    unsigned int idx = rand() % entry.size();
+    Mask mask = SubsetCoder().encode(node->hidden);
+    const std::vector<std::pair<Ratio, Node*>>& entry = table->lookup_table[mask];
+    unsigned int idx = rng() % entry.size();
     node->children.push_back(entry[idx].second);
     return;
   }
   for (Value v : node->values) {
-    unsigned int idx = rand() % (node->children.size() + 1);
+    unsigned int idx = rng() % (node->children.size() + 1);
     if (idx == node->children.size()) node->children.push_back(&N());
     auto child = node->children.begin();
     for (unsigned int i = 0; i < idx; i++) child++;
     (*child)->values.push_back(v);
   }
   node->values.clear();
-  for (auto child : node->children) randomly_expand(child);
+  for (auto child : node->children) randomly_expand(table, child, rng, expandables);
 }
 
-void LocalSolver::iteratively_improve(const Problem& problem, Node* network) {
-  Ratio best_cost = network_evaluator.evaluate_cost(problem, network);
-  while (true) {
-    int idx_0 = rand() % expandables.size();
-    int idx_1 = rand() % expandables.size();
+void iteratively_improve(const Problem& problem, const Tabulator* table, Node* network,
+                         const std::vector<Node*>& expandables, std::mt19937& rng, Stats& stats,
+                         const std::atomic<bool>* cancel) {
+  NetworkEvaluator evaluator;
+  STAT(++stats.evaluations);
+  Ratio best_cost = evaluator.evaluate_cost(problem, network);
+  while (!(cancel && cancel->load(std::memory_order_relaxed))) {
+    int idx_0 = rng() % expandables.size();
+    int idx_1 = rng() % expandables.size();
     if (idx_0 == idx_1) {
       Node* expandable = expandables[idx_0];
       expandable->children.clear();
-      Node* node = tabulator->binary_search(
-          problem, network, expandable, expandable->hidden);
+      STAT(++stats.binary_searches);
+      Node* node = table->binary_search(
+          problem, network, expandable, expandable->hidden, &stats);
       expandable->children.push_back(node);
     } else {
       Node* expandable_0 = expandables[idx_0];
       Node* expandable_1 = expandables[idx_1];
       expandable_0->children.clear();
       expandable_1->children.clear();
-      std::pair<Node*,Node*> nodes = tabulator->linear_search(
+      STAT(++stats.linear_searches);
+      std::pair<Node*,Node*> nodes = table->linear_search(
         problem, network, expandable_0, expandable_1, expandable_0->hidden,
-        expandable_1->hidden);
+        expandable_1->hidden, &stats);
       expandable_0->children.push_back(nodes.first);
       expandable_1->children.push_back(nodes.second);
     }
-    Ratio cost = network_evaluator.evaluate_cost(problem, network);
+    STAT(++stats.nodes; ++stats.evaluations);
+    Ratio cost = evaluator.evaluate_cost(problem, network);
     if (best_cost <= cost) break;
     best_cost = cost;
   }
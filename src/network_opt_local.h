@@ -15,23 +15,53 @@ limitations under the License.
 #define _NETWORK_OPT_LOCAL_H_
 
 #include "network_opt.h"
+#include <random>
 
 namespace network_opt {
 
+// Splits the values of node at random into a series-parallel network whose
+// leaves are expandables of at most table->m values (appended to
+// expandables), each holding a random entry of the table.
+void randomly_expand(const Tabulator* table, Node* node, std::mt19937& rng, std::vector<Node*>& expandables);
+// Replaces the entries of one or two random expandables of network with the
+// best that a table search finds, until that stops lowering the cost or
+// *cancel (if not NULL) is set.
+void iteratively_improve(const Problem& problem, const Tabulator* table, Node* network,
+                         const std::vector<Node*>& expandables, std::mt19937& rng, Stats& stats,
+                         const std::atomic<bool>* cancel = NULL);
+
 struct LocalSolver {
-  LocalSolver(const Params& params);
+  // Improvements are reported to progress (if not NULL) as they are found.
+  LocalSolver(const Params& params, unsigned int seed = 2022, std::ostream* progress = &std::cout);
+  // Searches with a table that the caller has already tabulated.
+  LocalSolver(const Params& params, const Tabulator* shared_tabulator, unsigned int seed = 2022,
+              std::ostream* progress = &std::cout);
   ~LocalSolver();
+  // Restarts until params.time_limit elapses or params.cancel is set (forever
+  // if neither is given), or until the k best costs are within params.tolerance.
   Node* solve(const Problem& problem);
+  // The params.k best distinct networks found by the last solve(), best first.
+  const std::vector<Node*>& solutions() const { return top.all(); }
+  // Of the last call to solve(), including tabulation by an owned Tabulator.
+  const Stats& get_stats() const { return stats; }
+  const Tabulator* get_table() const { return table; }
+  // Writes a JSON line to os (if not NULL) for every new best network.
+  void set_trace(std::ostream* os) { trace = os; }
+  void set_observer(const IncumbentObserver& _observer) { observer = _observer; }
 
  private:
+  Params params;
   Bounder* bounder;
   Tabulator* tabulator;
-  Node* best_network;
+  const Tabulator* table;
+  TopNetworks top;
+  std::ostream* progress;
+  std::ostream* trace;
+  IncumbentObserver observer;
   std::vector<Node*> expandables;
-
-  void clear();
-  void randomly_expand(Node* node);
-  void iteratively_improve(const Problem& problem, Node* network);
+  NetworkEvaluator evaluator;
+  std::mt19937 rng;
+  Stats stats;
 };
     
 }
@@ -11,25 +11,509 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+// The abseil headers come first, since network_opt.h defines the N macro.
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/numbers.h"
+#include "network_opt_batch.h"
+#include "network_opt_cache.h"
+#include "network_opt_evolve.h"
+#include "network_opt_index.h"
+#include "network_opt_ladder.h"
 #include "network_opt_local.h"
-#include "stdlib.h"
+#include "network_opt_serve.h"
+#include "network_opt_shard.h"
+#include "network_opt_supply.h"
+#include "network_opt_sweep.h"
+#include "network_opt_tolerance.h"
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+ABSL_FLAG(unsigned int, threads, std::thread::hardware_concurrency(),
+          "Number of worker threads used by BATCH, SERVE and EVOLVE modes.");
+ABSL_FLAG(std::string, index, "", "Resistance index whose nearest network seeds OPT.");
+ABSL_FLAG(unsigned int, population, 32, "Number of individuals that EVOLVE keeps.");
+ABSL_FLAG(unsigned int, generations, 0, "Number of generations after which EVOLVE stops (0 for no limit).");
+ABSL_FLAG(bool, ladder, false, "Seed OPT with the best continued-fraction ladder, as LADDER builds.");
+ABSL_FLAG(unsigned int, tables, 8, "Number of tables that SERVE mode keeps in memory.");
+ABSL_FLAG(double, time_limit, 0,
+          "Wall-clock limit in seconds for OPT and LOCAL, and the default per-query limit of SERVE (0 for none).");
+ABSL_FLAG(std::string, tolerance, "0", "OPT and LOCAL stop once the cost is at most this (e.g. 1/1000).");
+ABSL_FLAG(std::string, trace, "", "File to which OPT and LOCAL write a JSON line per new best network.");
+ABSL_FLAG(unsigned int, top, 1, "Number of best distinct networks that OPT reports.");
+ABSL_FLAG(bool, stats, false, "Print search statistics after OPT.");
+ABSL_FLAG(std::string, checkpoint, "",
+          "File to which OPT saves its progress, and from which it resumes if the file exists.");
+ABSL_FLAG(double, checkpoint_interval, 60, "Seconds between the saves of --checkpoint.");
+ABSL_FLAG(std::string, shard, "0/1", "Makes OPT search only shard i of N (given as i/N) of the search space.");
+ABSL_FLAG(std::string, max_cost, "",
+          "OPT only looks for networks whose cost is at most this (e.g. the cost of a known network).");
+ABSL_FLAG(unsigned int, transpositions, 0,
+          "Makes OPT skip the last 2^N distinct partial networks it visited when they recur (0 for none).");
+ABSL_FLAG(double, table_memory, 1024, "Memory budget in MiB for the table when <m> is AUTO.");
+ABSL_FLAG(double, table_seconds, 0, "Time budget in seconds for tabulation when <m> is AUTO (0 for none).");
+ABSL_FLAG(bool, analyze, false, "Analyze the tolerance of every network that OPT or LOCAL reports, as ANALYZE does.");
+ABSL_FLAG(double, part_tolerance, 0.05, "Relative tolerance of the parts for ANALYZE and --analyze.");
+ABSL_FLAG(bool, normal_parts, false, "Parts vary normally with sigma = part_tolerance / 3, instead of uniformly.");
+ABSL_FLAG(double, spec, 0.01, "Relative distance from the target within which a sampled network passes.");
+ABSL_FLAG(unsigned long long, samples, 1000000, "Number of Monte-Carlo samples of ANALYZE and --analyze.");
+ABSL_FLAG(std::string, result, "", "File to which OPT writes its result as a JSON line, for MERGE.");
+ABSL_FLAG(bool, single_pass, false,
+          "Makes BATCH read all of its input, then solve the targets of each series and n in one search.");
+ABSL_FLAG(bool, inventory, false, "Makes OPT find the best network that uses any subset of the n parts.");
+ABSL_FLAG(unsigned int, max_parts, 0, "With --inventory, the most parts that a network may use (0 for any).");
+ABSL_FLAG(std::string, kind, "RESISTANCE",
+          "What the series and target measure: RESISTANCE, CAPACITANCE, or CONDUCTANCE (of a resistor network).");
+ABSL_FLAG(std::string, table, "",
+          "Table file that OPT and LOCAL load if it exists, and otherwise tabulate and save for the next run.");
+ABSL_FLAG(std::string, cache, "",
+          "Solution cache file that answers repeated OPT, LOCAL and SERVE searches, created if it does not exist.");
+
+const double MIB = 1 << 20;
+
+const char USAGE[] =
+    "Usage: network_opt (OPT|LOCAL) <b> (<m>|AUTO) <n> <series> <target>\n"
+    "       network_opt EVOLVE <b> <m> <n> <series> <target>\n"
+    "       network_opt SWEEP <b> <m> <n> <series> <target>\n"
+    "       network_opt BATCH <b> <m> [<file>]\n"
+    "       network_opt INDEX <m> <limit> <n> <series> <file>\n"
+    "       network_opt NEAREST <file> <n> <series> <target>\n"
+    "       network_opt SUPPLY <k> <series> <target>\n"
+    "       network_opt LADDER <n> <series> <target>\n"
+    "       network_opt SERVE [<socket>]\n"
+    "       network_opt MERGE <n> <series> <target> <file>...\n"
+    "       network_opt ANALYZE <n> <series> <target> <network>";
 
 int main(int argc, char *argv[]) {
-  std::cout << " Command:";
-  for (int i = 0; i < argc; ++i) std::cout << " " << argv[i];
-  std::cout << std::endl;
-  std::string solver = argv[1];
-  unsigned int b = atoi(argv[2]), t = atoi(argv[3]);
-  network_opt::Problem problem = network_opt::Problem::from_argv(argv);
+  std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+  std::string solver = (args.size() > 1) ? args[1] : "";
+  // Keep stdout machine-readable in batch and server modes.
+  std::ostream& log = (solver == "BATCH" || solver == "SERVE") ? std::cerr : std::cout;
+  log << " Command:";
+  for (int i = 0; i < argc; ++i) log << " " << argv[i];
+  log << std::endl;
+  network_opt::Problem::Kind kind;
+  if (!network_opt::parse_kind(absl::GetFlag(FLAGS_kind), &kind)) {
+    std::cerr << "Invalid kind: " << absl::GetFlag(FLAGS_kind) << std::endl;
+    return 1;
+  }
+  std::unique_ptr<network_opt::SolutionCache> cache;
+  if (!absl::GetFlag(FLAGS_cache).empty()) {
+    absl::StatusOr<std::unique_ptr<network_opt::SolutionCache>> opened =
+        network_opt::SolutionCache::open(absl::GetFlag(FLAGS_cache));
+    if (!opened.ok()) {
+      std::cerr << opened.status() << std::endl;
+      return 1;
+    }
+    cache = std::move(*opened);
+  }
+  if (solver == "SERVE" && args.size() <= 3) {
+    network_opt::Server server(absl::GetFlag(FLAGS_tables), absl::GetFlag(FLAGS_threads),
+                               absl::GetFlag(FLAGS_time_limit), cache.get());
+    if (args.size() == 2) {
+      server.serve(std::cin, std::cout);
+      return 0;
+    }
+    absl::Status status = server.serve(args[2]);
+    std::cerr << status << std::endl;
+    return 1;
+  }
+  if (solver == "NEAREST" && args.size() == 6) {
+    absl::StatusOr<network_opt::Problem> problem = network_opt::Problem::from_spec(args[4], args[3], args[5]);
+    if (problem.ok()) problem->kind = kind;
+    absl::StatusOr<std::unique_ptr<network_opt::ResistanceIndex>> index = network_opt::ResistanceIndex::open(args[2]);
+    if (!problem.ok() || !index.ok()) {
+      std::cerr << (problem.ok() ? index.status() : problem.status()) << std::endl;
+      return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    absl::StatusOr<network_opt::Node*> network = (*index)->nearest(*problem);
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    if (!network.ok()) {
+      std::cerr << network.status() << std::endl;
+      return 1;
+    }
+    network_opt::print_summary(std::cout, *problem, *network, "");
+    std::cout << "   Index: " << (*index)->size() << " totals (" << ((*index)->complete() ? "complete" : "partial")
+              << "), answered in " << elapsed.count() << " us" << std::endl;
+    delete *network;
+    return 0;
+  }
+  if (solver == "LADDER" && args.size() == 5) {
+    absl::StatusOr<network_opt::Problem> problem = network_opt::Problem::from_spec(args[3], args[2], args[4]);
+    if (!problem.ok()) {
+      std::cerr << problem.status() << std::endl;
+      return 1;
+    }
+    problem->kind = kind;
+    auto start = std::chrono::steady_clock::now();
+    network_opt::Node* network = network_opt::best_ladder(*problem);
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    network_opt::print_summary(std::cout, *problem, network, "");
+    std::cout << "  Ladder: built in " << elapsed.count() << " us" << std::endl;
+    delete network;
+    return 0;
+  }
+  if (solver == "SUPPLY" && args.size() == 5) {
+    absl::StatusOr<network_opt::Problem> problem = network_opt::Problem::from_supply_spec(args[3], args[2], args[4]);
+    if (!problem.ok()) {
+      std::cerr << problem.status() << std::endl;
+      return 1;
+    }
+    problem->kind = kind;
+    auto start = std::chrono::steady_clock::now();
+    network_opt::SupplyTable table(problem->elements, problem->max_parts);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    unsigned int parts = 0;
+    network_opt::Node* network = table.nearest(*problem, &parts);
+    network_opt::print_summary(std::cout, *problem, network, "");
+    std::cout << "   Parts: " << parts << " of at most " << problem->max_parts
+              << std::endl;
+    std::cout << "  Supply: " << table.size() << " totals, tabulated in " << elapsed.count() << " s" << std::endl;
+    delete network;
+    return 0;
+  }
+  network_opt::ToleranceParams tolerance_params;
+  tolerance_params.tolerance = absl::GetFlag(FLAGS_part_tolerance);
+  tolerance_params.normal = absl::GetFlag(FLAGS_normal_parts);
+  tolerance_params.spec = absl::GetFlag(FLAGS_spec);
+  tolerance_params.samples = absl::GetFlag(FLAGS_samples);
+  tolerance_params.threads = std::max(absl::GetFlag(FLAGS_threads), 1u);
+  if (solver == "ANALYZE" && args.size() == 6) {
+    absl::StatusOr<network_opt::Problem> problem = network_opt::Problem::from_spec(args[3], args[2], args[4]);
+    if (problem.ok()) problem->kind = kind;
+    network_opt::Node* network = network_opt::Node::parse(args[5]);
+    if (!problem.ok() || !network) {
+      std::cerr << (problem.ok() ? "Invalid network: " + std::string(args[5]) : problem.status().ToString())
+                << std::endl;
+      return 1;
+    }
+    network_opt::print_summary(std::cout, *problem, network, "");
+    auto start = std::chrono::steady_clock::now();
+    network_opt::ToleranceAnalysis analysis = network_opt::analyze_tolerance(*problem, network, tolerance_params);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    network_opt::print_tolerance(std::cout, analysis, tolerance_params, "");
+    std::cout << "    Time: " << elapsed.count() << " s (" << tolerance_params.samples / elapsed.count()
+              << " samples/second)" << std::endl;
+    delete network;
+    return 0;
+  }
+  if (solver == "MERGE" && args.size() >= 6) {
+    absl::StatusOr<network_opt::Problem> problem = network_opt::Problem::from_spec(args[3], args[2], args[4]);
+    if (problem.ok()) problem->kind = kind;
+    if (!problem.ok()) {
+      std::cerr << problem.status() << std::endl;
+      return 1;
+    }
+    problem->inventory = absl::GetFlag(FLAGS_inventory);
+    problem->max_parts = absl::GetFlag(FLAGS_max_parts);
+    std::vector<std::string> lines;
+    for (unsigned int i = 5; i < args.size(); ++i) {
+      std::ifstream file(args[i]);
+      if (!file) {
+        std::cerr << "Cannot open " << args[i] << std::endl;
+        return 1;
+      }
+      for (std::string line; std::getline(file, line); )
+        if (!line.empty()) lines.push_back(line);
+    }
+    network_opt::ShardMerge merge;
+    absl::Status status = network_opt::merge_shard_results(*problem, lines, &merge);
+    if (status.ok() && !merge.network) status = absl::NotFoundError("no shard found a network");
+    if (!status.ok()) {
+      std::cerr << status << std::endl;
+      return 1;
+    }
+    network_opt::print_summary(std::cout, *problem, merge.network, "");
+    std::cout << "  Shards: " << lines.size() << (merge.complete ? " complete" : " (some timed out)") << std::endl;
+    network_opt::NetworkEvaluator evaluator;
+    if (merge.lower_bound < evaluator.evaluate_cost(*problem, merge.network)) {
+      std::cout << "   Bound: " << boost::rational_cast<double>(merge.lower_bound)
+                << " (proven lower bound on the search cost)" << std::endl;
+    }
+    return 0;
+  }
+  unsigned int b = 0, t = 0;
+  bool auto_m = args.size() >= 4 && std::string(args[3]) == "AUTO" && (solver == "OPT" || solver == "LOCAL");
+  if (args.size() < 4 || !absl::SimpleAtoi(args[2], &b) || (!auto_m && !absl::SimpleAtoi(args[3], &t))) {
+    std::cerr << USAGE << std::endl;
+    return 1;
+  }
   network_opt::Params params(b, t);
+  params.k = std::max(absl::GetFlag(FLAGS_top), 1u);
+  params.time_limit = absl::GetFlag(FLAGS_time_limit);
+  params.transposition_bits = absl::GetFlag(FLAGS_transpositions);
+  if (!network_opt::parse_ratio(absl::GetFlag(FLAGS_tolerance), &params.tolerance)) {
+    std::cerr << "Invalid tolerance: " << absl::GetFlag(FLAGS_tolerance) << std::endl;
+    return 1;
+  }
+  if (!network_opt::parse_shard(absl::GetFlag(FLAGS_shard), &params.shard, &params.shards)) {
+    std::cerr << "Invalid shard: " << absl::GetFlag(FLAGS_shard) << std::endl;
+    return 1;
+  }
+  // Other modes would silently answer from one shard of the search.
+  if (params.shards > 1 && solver != "OPT") {
+    std::cerr << "--shard is only supported by OPT" << std::endl;
+    return 1;
+  }
+  if (!absl::GetFlag(FLAGS_max_cost).empty() &&
+      !network_opt::parse_ratio(absl::GetFlag(FLAGS_max_cost), &params.max_cost)) {
+    std::cerr << "Invalid max_cost: " << absl::GetFlag(FLAGS_max_cost) << std::endl;
+    return 1;
+  }
+  std::ofstream trace;
+  if (!absl::GetFlag(FLAGS_trace).empty()) {
+    trace.open(absl::GetFlag(FLAGS_trace));
+    if (!trace) {
+      std::cerr << "Cannot open " << absl::GetFlag(FLAGS_trace) << std::endl;
+      return 1;
+    }
+  }
+  if (solver == "BATCH" && args.size() <= 5) {
+    std::ifstream file;
+    if (args.size() == 5) {
+      file.open(args[4]);
+      if (!file) {
+        std::cerr << "Cannot open " << args[4] << std::endl;
+        return 1;
+      }
+    }
+    network_opt::BatchSolver batch_solver(params, absl::GetFlag(FLAGS_threads), absl::GetFlag(FLAGS_single_pass));
+    auto start = std::chrono::steady_clock::now();
+    unsigned int count = batch_solver.solve(file.is_open() ? file : std::cin, std::cout);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cerr << "Solved " << count << " targets in " << elapsed.count() << " seconds ("
+              << count / elapsed.count() << " targets/second)" << std::endl;
+    return 0;
+  }
+  if (args.size() != 7) {
+    std::cerr << USAGE << std::endl;
+    return 1;
+  }
+  if (solver == "INDEX") {
+    absl::StatusOr<network_opt::Problem> problem = network_opt::Problem::from_spec(args[5], args[4], "SQRT");
+    absl::Status status = problem.ok() ? network_opt::ResistanceIndex::build(*problem, b, t, args[6])
+                                       : problem.status();
+    if (!status.ok()) {
+      std::cerr << status << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+  absl::StatusOr<network_opt::Problem> problem = network_opt::Problem::from_spec(args[5], args[4], args[6]);
+  if (!problem.ok()) {
+    std::cerr << problem.status() << std::endl;
+    return 1;
+  }
+  problem->kind = kind;
+  problem->inventory = absl::GetFlag(FLAGS_inventory);
+  problem->max_parts = absl::GetFlag(FLAGS_max_parts);
+  if (problem->inventory && solver != "OPT") {
+    std::cerr << "--inventory is only supported by OPT" << std::endl;
+    return 1;
+  }
+  network_opt::TableEstimate estimate;
+  if (auto_m) {
+    params.m = network_opt::choose_m(problem->size(), absl::GetFlag(FLAGS_table_memory) * MIB,
+                                     absl::GetFlag(FLAGS_table_seconds));
+    estimate = network_opt::estimate_table(problem->size(), params.m);
+    if (!params.m && solver == "LOCAL") {
+      std::cerr << "LOCAL needs a table, but none fits in --table_memory and --table_seconds" << std::endl;
+      return 1;
+    }
+  }
+  // Compares the estimate that chose m with the table that was built.
+  auto print_table = [&](const network_opt::Tabulator* table, const network_opt::Stats& stats) {
+    if (!auto_m) return;
+    std::cout << "   Table: m=" << params.m << " for a budget of " << absl::GetFlag(FLAGS_table_memory) << " MiB";
+    if (absl::GetFlag(FLAGS_table_seconds) > 0) std::cout << " and " << absl::GetFlag(FLAGS_table_seconds) << " s";
+    std::cout << std::setprecision(4) << ", estimated " << estimate.bytes / MIB << " MiB in "
+              << estimate.seconds << " s";
+    if (table) std::cout << ", actual " << table->bytes() / MIB << " MiB";
+    if (table && network_opt::Stats::enabled) std::cout << " in " << stats.tabulate_seconds << " s";
+    std::cout << std::endl;
+  };
+  std::function<network_opt::ToleranceAnalysis(network_opt::Node*)> analyze;
+  if (absl::GetFlag(FLAGS_analyze)) {
+    analyze = [&](network_opt::Node* network) {
+      return network_opt::analyze_tolerance(*problem, network, tolerance_params);
+    };
+  }
+  // Only the best network is cached, so --top and --result always search.
+  bool cached = cache && (solver == "OPT" || solver == "LOCAL") && params.k == 1 &&
+                absl::GetFlag(FLAGS_result).empty();
+  network_opt::CachedSolution solution;
+  if (cached && cache->lookup(*problem, solver, params, &solution)) {
+    std::unique_ptr<network_opt::Node> network(network_opt::Node::parse(solution.network));
+    network->ratio = solution.cost;
+    network_opt::print_summary(std::cout, *problem, network.get(), "");
+    std::cout << "   Cache: ";
+    if (solution.optimal) std::cout << "proven optimal"; else std::cout << "found by " << solver;
+    if (!solution.optimal && solution.budget) std::cout << " in a time limit of " << solution.budget << " s";
+    std::cout << std::endl;
+    if (analyze) network_opt::print_tolerance(std::cout, analyze(network.get()), tolerance_params, "");
+    return 0;
+  }
+  // Reports a failure to remember the network, which was still found.
+  auto remember = [&](const network_opt::Node* network, bool optimal) {
+    if (!cached) return;
+    absl::Status status = cache->insert(*problem, solver, params, network, optimal);
+    if (!status.ok()) std::cerr << status << std::endl;
+  };
+  // A table saved by an earlier run serves any target and kind over the same elements.
+  std::unique_ptr<network_opt::Tabulator> table;
+  std::string table_path = absl::GetFlag(FLAGS_table);
+  if (!table_path.empty() && params.m) {
+    table = std::make_unique<network_opt::Tabulator>(params.m);
+    absl::Status status;
+    if (std::ifstream(table_path)) {
+      status = table->load(*problem, table_path);
+    } else {
+      table->tabulate(*problem);
+      status = table->save(*problem, table_path);
+    }
+    if (!status.ok()) {
+      std::cerr << status << std::endl;
+      return 1;
+    }
+  }
   if (solver == "OPT") {
-    network_opt::Solver solver(params);
-    network_opt::Node* network = solver.solve(problem);
-    network_opt::print_summary(std::cout, problem, network, "");
-  } else if (solver == "LOCAL") {
-    srand(2022);
-    network_opt::LocalSolver solver(params);
-    network_opt::Node* network = solver.solve(problem);
-    network_opt::print_summary(std::cout, problem, network, "");
+    network_opt::Solver solver = table ? network_opt::Solver(params, table.get()) : network_opt::Solver(params);
+    if (trace.is_open()) solver.set_trace(&trace);
+    std::string checkpoint = absl::GetFlag(FLAGS_checkpoint);
+    if (!checkpoint.empty()) {
+      solver.set_checkpoint(checkpoint, absl::GetFlag(FLAGS_checkpoint_interval));
+      if (std::ifstream(checkpoint)) {
+        absl::Status status = solver.resume(*problem, checkpoint);
+        if (!status.ok()) {
+          std::cerr << status << std::endl;
+          return 1;
+        }
+        std::cout << "Resuming from " << checkpoint << std::endl;
+      }
+    }
+    if (!absl::GetFlag(FLAGS_index).empty()) {
+      absl::StatusOr<std::unique_ptr<network_opt::ResistanceIndex>> index =
+          network_opt::ResistanceIndex::open(absl::GetFlag(FLAGS_index));
+      absl::StatusOr<network_opt::Node*> seed = index.ok() ? (*index)->nearest(*problem) : index.status();
+      if (!seed.ok()) {
+        std::cerr << seed.status() << std::endl;
+        return 1;
+      }
+      network_opt::print_summary(std::cout, *problem, *seed, "  Seed ");
+      solver.seed(*seed);
+      delete *seed;
+    }
+    if (absl::GetFlag(FLAGS_ladder)) {
+      network_opt::Node* seed = network_opt::best_ladder(*problem);
+      network_opt::print_summary(std::cout, *problem, seed, "  Seed ");
+      solver.seed(seed);
+      delete seed;
+    }
+    network_opt::Node* network = solver.solve(*problem);
+    remember(network, !solver.timed_out() && !params.tolerance);
+    if (!solver.get_checkpoint_status().ok()) std::cerr << solver.get_checkpoint_status() << std::endl;
+    if (!checkpoint.empty() && !solver.timed_out()) std::remove(checkpoint.c_str());
+    if (!absl::GetFlag(FLAGS_result).empty()) {
+      std::ofstream result(absl::GetFlag(FLAGS_result));
+      network_opt::print_shard_result(result, *problem, params, solver, network);
+      if (!result) {
+        std::cerr << "Cannot write " << absl::GetFlag(FLAGS_result) << std::endl;
+        return 1;
+      }
+    }
+    if (!network) {
+      std::cout << "Solution: none found" << std::endl;
+      return 0;
+    }
+    network_opt::print_summary(std::cout, *problem, network, "",
+                               absl::GetFlag(FLAGS_stats) ? &solver.get_stats() : NULL);
+    if (problem->inventory) {
+      std::cout << "   Parts: " << __builtin_popcount(network_opt::used_elements(network)) << " of "
+                << problem->size() << std::endl;
+    }
+    if (solver.get_lower_bound() < network->ratio) {
+      std::cout << "   Bound: " << boost::rational_cast<double>(solver.get_lower_bound())
+                << " (proven lower bound on the search cost "
+                << boost::rational_cast<double>(network->ratio) << ")" << std::endl;
+    }
+    print_table(solver.get_table(), solver.get_stats());
+    std::vector<std::pair<double, unsigned int>> yields;
+    for (unsigned int i = 0; i < solver.solutions().size(); ++i) {
+      std::string prefix = i ? "  #" + std::to_string(i + 1) + " " : "";
+      if (i) {
+        std::cout << std::endl;
+        network_opt::print_summary(std::cout, *problem, solver.solutions()[i], prefix);
+      }
+      if (!analyze) continue;
+      network_opt::ToleranceAnalysis analysis = analyze(solver.solutions()[i]);
+      network_opt::print_tolerance(std::cout, analysis, tolerance_params, prefix);
+      yields.emplace_back(-analysis.yield, i);
+    }
+    if (yields.size() > 1) {
+      std::sort(yields.begin(), yields.end());
+      std::cout << std::endl << "  Robust:";
+      for (auto [yield, i] : yields) std::cout << " #" << i + 1 << " (" << -100 * yield << "%)";
+      std::cout << std::endl;
+    }
+  } else if (solver == "EVOLVE" && t) {
+    network_opt::EvolutionParams evolution;
+    evolution.population = absl::GetFlag(FLAGS_population);
+    evolution.generations = absl::GetFlag(FLAGS_generations);
+    evolution.threads = std::max(absl::GetFlag(FLAGS_threads), 1u);
+    if (!evolution.generations && !params.time_limit) {
+      std::cerr << "EVOLVE needs --time_limit or --generations" << std::endl;
+      return 1;
+    }
+    network_opt::EvolutionSolver solver = table ? network_opt::EvolutionSolver(params, table.get(), evolution)
+                                                : network_opt::EvolutionSolver(params, evolution);
+    if (trace.is_open()) solver.set_trace(&trace);
+    network_opt::Node* network = solver.solve(*problem);
+    network_opt::print_summary(std::cout, *problem, network, "",
+                               absl::GetFlag(FLAGS_stats) ? &solver.get_stats() : NULL);
+    std::cout << "  Evolve: " << solver.get_generations() << " generations of " << evolution.population
+              << " on " << evolution.threads << " threads" << std::endl;
+    print_table(solver.get_table(), solver.get_stats());
+    if (analyze) network_opt::print_tolerance(std::cout, analyze(network), tolerance_params, "");
+  } else if (solver == "SWEEP") {
+    // The problems of 1 to n elements, where SQRT is the square root of each.
+    std::vector<network_opt::Problem> problems;
+    for (unsigned int n = 1; n <= problem->size(); ++n) {
+      problems.push_back(*network_opt::Problem::from_spec(args[5], std::to_string(n), args[6]));
+      problems.back().kind = kind;
+    }
+    network_opt::SweepSolver solver = table ? network_opt::SweepSolver(params, table.get())
+                                            : network_opt::SweepSolver(params);
+    absl::StatusOr<std::vector<network_opt::SweepPoint>> points = solver.solve(problems);
+    if (!points.ok()) {
+      std::cerr << points.status() << std::endl;
+      return 1;
+    }
+    std::cout << "       n          Cost     Seed cost   Seconds  Solution" << std::endl;
+    for (unsigned int i = 0; i < points->size(); ++i) {
+      const network_opt::SweepPoint& point = (*points)[i];
+      std::cout << std::setw(8) << i + 1 << std::setprecision(4);
+      if (!point.network) {
+        std::cout << "  none found" << std::endl;
+        continue;
+      }
+      std::cout << std::setw(14) << boost::rational_cast<double>(point.cost) << std::setw(14);
+      if (point.seed_cost < 0) std::cout << "-"; else std::cout << boost::rational_cast<double>(point.seed_cost);
+      std::cout << std::setw(10) << point.seconds << "  " << point.network->to_string(problems[i])
+                << (point.optimal ? "" : " (not proven optimal)") << std::endl;
+    }
+  } else if (solver == "LOCAL" && params.m) {
+    network_opt::LocalSolver solver = table ? network_opt::LocalSolver(params, table.get(), 2022)
+                                            : network_opt::LocalSolver(params, 2022);
+    if (trace.is_open()) solver.set_trace(&trace);
+    network_opt::Node* network = solver.solve(*problem);
+    remember(network, false);
+    network_opt::print_summary(std::cout, *problem, network, "");
+    print_table(solver.get_table(), solver.get_stats());
+    if (analyze) network_opt::print_tolerance(std::cout, analyze(network), tolerance_params, "");
+  } else {
+    std::cerr << USAGE << std::endl;
+    return 1;
   }
 }
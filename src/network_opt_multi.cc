@@ -0,0 +1,201 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "network_opt_multi.h"
+#include <unordered_map>
+
+namespace network_opt {
+
+MultiSolver::MultiSolver(const Params& _params)
+    : params(_params), tabulator(NULL), table(NULL), stopped(false), problems(NULL) {
+  if (params.m) table = tabulator = new Tabulator(params.m);
+}
+
+MultiSolver::MultiSolver(const Params& _params, const Tabulator* shared_tabulator)
+    : params(_params), tabulator(NULL), table(shared_tabulator), stopped(false), problems(NULL) {}
+
+MultiSolver::~MultiSolver() {
+  if (tabulator) delete tabulator;
+}
+
+std::vector<Node*> MultiSolver::solve(const std::vector<Problem>& _problems) {
+  problems = &_problems;
+  deadline = Deadline(params.time_limit, 256, params.cancel);
+  stopped = false;
+  stats = Stats();
+  tops.clear();
+  std::vector<unsigned int> active;
+  for (unsigned int i = 0; i < problems->size(); ++i) {
+    assert((*problems)[i].elements == problems->front().elements);
+    tops.emplace_back(params.k);
+    active.push_back(i);
+  }
+  std::vector<Node*> networks;
+  if (problems->empty()) return networks;
+  const Problem& problem = problems->front();
+  Node* network = &N();
+  if (tabulator) tabulator->tabulate(problem);
+  STAT(if (tabulator) stats = tabulator->stats);
+  STAT(auto search_start = std::chrono::steady_clock::now());
+  for (auto mask : inventory_subsets(problem)) {
+    network->values.clear();
+    for (Value i = 0; i < problem.size(); ++i) if (mask >> i & 1) network->values.push_back(i);
+    solve(network, active);
+  }
+  STAT(stats.search_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - search_start).count());
+  delete network;
+  for (auto& top : tops) networks.push_back(top.best());
+  return networks;
+}
+
+bool MultiSolver::improves(unsigned int i, const Ratio& bound) const {
+  if (params.max_cost >= 0 && bound > params.max_cost) return false;
+  const TopNetworks& top = tops[i];
+  return !top.full() || (bound < top.cutoff() && top.cutoff() > params.tolerance);
+}
+
+void MultiSolver::offer(unsigned int i, Node* network, const Ratio& total) {
+  STAT(++stats.leaves);
+  Ratio cost = (*problems)[i].get_cost(total);
+  if (cost < 0) cost = -cost;
+  if (params.max_cost < 0 || cost <= params.max_cost) tops[i].offer((*problems)[i], network, cost);
+}
+
+void MultiSolver::solve(Node* network, const std::vector<unsigned int>& active) {
+  if (stopped || (stopped = deadline.expired())) return;
+  STAT(++stats.nodes);
+  const Problem& problem = problems->front();  // For the elements, which all problems share.
+  // The problems that this subtree may still improve.
+  std::vector<unsigned int> live;
+  bool bounding = params.b && params.max_cost >= 0;
+  for (auto i : active) bounding = bounding || (params.b && tops[i].full());
+  if (bounding) {
+    STAT(++stats.bounds; stats.evaluations += 2);
+    Ratio lower = evaluator.evaluate_total(problem, network, -1);
+    Ratio upper = evaluator.evaluate_total(problem, network, 1);
+    for (auto i : active) {
+      const Problem& target = (*problems)[i];
+      if (improves(i, std::max(target.get_cost(lower), -target.get_cost(upper)))) live.push_back(i);
+    }
+  } else {
+    for (auto i : active) if (improves(i, Ratio(-1))) live.push_back(i);
+  }
+  if (live.empty()) {
+    STAT(++stats.prunes);
+    return;
+  }
+  Expander expander(network);
+  Node* expandable_0 = expander.expandable();
+  if (!expandable_0) {
+    STAT(++stats.evaluations);
+    Ratio total = evaluator.evaluate_total(problem, network);
+    for (auto i : live) offer(i, network, total);
+    return;
+  }
+  Node* expandable_1 = expander.expandable();
+  Node* expandable_2 = expandable_1 ? expander.expandable() : NULL;
+  Values values_0 = expandable_0->values; expandable_0->values.clear();
+  if (table && !expandable_1 && values_0.size() <= table->m) {
+    // Every problem searches the same sorted entries, whose totals are
+    // evaluated once, when some problem first probes them.
+    STAT(++stats.binary_searches);
+    const std::vector<std::pair<Ratio, Node*>>& entry = table->lookup_table[coder.encode(values_0)];
+    std::vector<Ratio> totals(entry.size());
+    std::vector<bool> known(entry.size());
+    auto total = [&](unsigned int idx) -> const Ratio& {
+      if (!known[idx]) {
+        STAT(++stats.probes; ++stats.evaluations);
+        expandable_0->children.push_back(entry[idx].second);
+        totals[idx] = evaluator.evaluate_total(problem, network);
+        expandable_0->children.pop_back();
+        known[idx] = true;
+      }
+      return totals[idx];
+    };
+    for (auto i : live) {
+      // The first entry whose cost is not negative; the cost is unimodal
+      // over the entries, so the k best lie within k entries of it.
+      unsigned int lo = 0, hi = entry.size();
+      while (lo < hi) {
+        unsigned int mid = (lo + hi) / 2;
+        if ((*problems)[i].get_cost(total(mid)) < 0) lo = mid + 1; else hi = mid;
+      }
+      unsigned int begin = (lo >= params.k) ? lo - params.k : 0;
+      unsigned int end = std::min<unsigned int>(lo + params.k, entry.size());
+      for (unsigned int idx = begin; idx < end; ++idx) {
+        const Ratio& entry_total = total(idx);
+        expandable_0->children.push_back(entry[idx].second);
+        offer(i, network, entry_total);
+        expandable_0->children.pop_back();
+      }
+    }
+  } else if (table && expandable_1 && !expandable_2 && params.k == 1 &&
+             values_0.size() <= table->m &&
+             expandable_1->values.size() <= table->m) {
+    // Each problem walks the pairs of entries as linear_search() does, and
+    // problems with close targets walk mostly the same pairs.
+    Values values_1 = expandable_1->values; expandable_1->values.clear();
+    STAT(++stats.linear_searches);
+    const std::vector<std::pair<Ratio, Node*>>& entry_0 = table->lookup_table[coder.encode(values_0)],
+                                              & entry_1 = table->lookup_table[coder.encode(values_1)];
+    std::unordered_map<uint64_t, Ratio> totals;
+    auto total = [&](unsigned int idx_0, unsigned int idx_1) -> const Ratio& {
+      auto [it, inserted] = totals.try_emplace(uint64_t(idx_0) * entry_1.size() + idx_1);
+      if (inserted) {
+        STAT(++stats.probes; ++stats.evaluations);
+        expandable_0->children.push_back(entry_0[idx_0].second);
+        expandable_1->children.push_back(entry_1[idx_1].second);
+        it->second = evaluator.evaluate_total(problem, network);
+        expandable_1->children.pop_back();
+        expandable_0->children.pop_back();
+      }
+      return it->second;
+    };
+    for (auto i : live) {
+      unsigned int lo = 0, best_lo = 0, best_hi = 0;
+      int hi = entry_1.size() - 1;
+      Ratio best_cost = -1;
+      while (lo < entry_0.size() && hi >= 0) {
+        Ratio cost = (*problems)[i].get_cost(total(lo, hi));
+        Ratio abs_cost = (cost > 0) ? cost : -cost;
+        if (best_cost < 0 || best_cost > abs_cost) {
+          best_cost = abs_cost; best_lo = lo; best_hi = hi;
+        }
+        if (cost < 0) lo += 1; else hi -= 1;
+      }
+      const Ratio& best_total = total(best_lo, best_hi);
+      expandable_0->children.push_back(entry_0[best_lo].second);
+      expandable_1->children.push_back(entry_1[best_hi].second);
+      offer(i, network, best_total);
+      expandable_1->children.pop_back();
+      expandable_0->children.pop_back();
+    }
+    expandable_1->values = values_1;
+  } else {
+    bool has_children = !expandable_0->children.empty();
+    Node* child = &N();
+    expandable_0->children.push_back(child);
+    Mask max_mask = 1 << (values_0.size() - 1);
+    for (Mask mask = 0; mask < max_mask; ++mask) {
+      coder.decode(mask, values_0, child->values, expandable_0->values);
+      if (has_children || !expandable_0->values.empty() || expandable_0 == network) solve(network, live);
+      child->values.clear();
+      expandable_0->values.clear();
+    }
+    expandable_0->children.pop_back();
+    delete child;
+  }
+  expandable_0->values = values_0;
+}
+
+}
@@ -0,0 +1,56 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _NETWORK_OPT_MULTI_H_
+#define _NETWORK_OPT_MULTI_H_
+
+#include "network_opt.h"
+#include <deque>
+
+namespace network_opt {
+
+// Solves several problems over the same elements, which may differ in their
+// target, square and kind, in a single pass over the search tree of Solver
+// (over the subsets of the inventory of the first problem, if it has one).
+// Each problem keeps its own incumbents.  A subtree is pruned once the range
+// of totals that bounds it cannot improve on any of them, and within a
+// subtree only the problems that it can still improve are considered.  The
+// table searches evaluate each entry (or pair of entries) at most once for
+// all problems.  The search honors params.b, m, k, time_limit, tolerance and
+// max_cost, but not shards or transpositions.
+struct MultiSolver {
+  MultiSolver(const Params& params);
+  // Searches with a table that the caller has already tabulated.
+  MultiSolver(const Params& params, const Tabulator* shared_tabulator);
+  ~MultiSolver();
+  // Returns the best network found for each problem (NULL if there is none
+  // within params.max_cost), which are optimal unless timed_out() or
+  // params.tolerance is non-zero.
+  std::vector<Node*> solve(const std::vector<Problem>& problems);
+  // The params.k best distinct networks found for problem i, best first.
+  const std::vector<Node*>& solutions(unsigned int i) const { return tops[i].all(); }
+  const Stats& get_stats() const { return stats; }
+  bool timed_out() const { return stopped; }
+
+ private: Params params; Tabulator* tabulator; const Tabulator* table; std::deque<TopNetworks> tops;
+  NetworkEvaluator evaluator; SubsetCoder coder; Deadline deadline; bool stopped; Stats stats;
+  const std::vector<Problem>* problems;
+  // Whether a subtree whose cost for problem i is at least bound can improve on it.
+  bool improves(unsigned int i, const Ratio& bound) const;
+  void offer(unsigned int i, Node* network, const Ratio& total);
+  void solve(Node* network, const std::vector<unsigned int>& active);
+};
+
+}
+
+#endif
@@ -0,0 +1,272 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "network_opt_serve.h"
+#include "network_opt_local.h"
+#include "absl/strings/numbers.h"
+#include <cstring>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace network_opt {
+
+const unsigned int MAX_SERVE_M = 5;
+
+bool parse_json_object(const std::string& json, std::map<std::string, std::string>& fields) {
+  size_t i = 0;
+  auto skip = [&]() { while (i < json.size() && isspace(json[i])) ++i; };
+  auto parse_string = [&](std::string& s) {
+    if (json[i++] != '"') return false;
+    while (i < json.size() && json[i] != '"') {
+      if (json[i] == '\\' && ++i == json.size()) return false;
+      s += json[i++];
+    }
+    return i++ < json.size();
+  };
+  skip();
+  if (i == json.size() || json[i++] != '{') return false;
+  skip();
+  if (i < json.size() && json[i] == '}') return ++i, true;
+  while (i < json.size()) {
+    std::string key, value;
+    skip();
+    if (i == json.size() || !parse_string(key)) return false;
+    skip();
+    if (i == json.size() || json[i++] != ':') return false;
+    skip();
+    if (i == json.size()) return false;
+    if (json[i] == '"') {
+      if (!parse_string(value)) return false;
+    } else {
+      while (i < json.size() && json[i] != ',' && json[i] != '}' && !isspace(json[i])) value += json[i++];
+      if (value.empty() || value[0] == '{' || value[0] == '[') return false;
+    }
+    fields[key] = value;
+    skip();
+    if (i == json.size()) return false;
+    if (json[i] == '}') return true;
+    if (json[i++] != ',') return false;
+  }
+  return false;
+}
+
+std::shared_ptr<const Tabulator> TableCache::get(const std::string& series, const Problem& problem,
+                                                 unsigned int m) {
+  std::shared_ptr<Entry> entry;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<Entry>& slot = entries[std::make_tuple(series, problem.size(), m)];
+    if (!slot) slot = std::make_shared<Entry>(m);
+    slot->used = ++clock;
+    entry = slot;
+    while (entries.size() > capacity) {
+      auto lru = entries.begin();
+      for (auto it = entries.begin(); it != entries.end(); ++it)
+        if (it->second->used < lru->second->used) lru = it;
+      entries.erase(lru);
+    }
+  }
+  std::call_once(entry->once, [&]() { entry->tabulator.tabulate(problem); });
+  return std::shared_ptr<const Tabulator>(entry, &entry->tabulator);
+}
+
+Server::Server(unsigned int tables, unsigned int threads, double _default_time_limit, SolutionCache* _solutions)
+    : cache(tables), default_time_limit(_default_time_limit), solutions(_solutions), stopping(false) {
+  for (unsigned int i = 0; i < std::max(threads, 1u); ++i) {
+    workers.emplace_back([this]() {
+      while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this]() { return stopping || !jobs.empty(); });
+        if (jobs.empty()) return;
+        std::function<void()> job = std::move(jobs.front()); jobs.pop_front();
+        lock.unlock();
+        job();
+      }
+    });
+  }
+}
+
+Server::~Server() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  cv.notify_all();
+  for (auto& worker : workers) worker.join();
+}
+
+void Server::submit(const std::function<void()>& job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(job);
+  }
+  cv.notify_one();
+}
+
+std::string Server::answer(const std::string& query, const std::atomic<bool>* cancel) {
+  auto start = std::chrono::steady_clock::now();
+  std::map<std::string, std::string> fields;
+  std::ostringstream os;
+  bool ok = parse_json_object(query, fields);
+  std::string id = fields.count("id") ? fields["id"] : "null";
+  double number;
+  os << "{\"id\":" << (absl::SimpleAtod(id, &number) || id == "null" ? id : "\"" + json_escape(id) + "\"") << ",";
+  auto error = [&](const std::string& message) {
+    os << "\"error\":\"" << json_escape(message) << "\"}";
+    return os.str();
+  };
+  if (!ok) return error("malformed query");
+  std::string series = fields.count("series") ? fields["series"] : "E12";
+  std::string solver = fields.count("solver") ? fields["solver"] : "OPT";
+  if (!fields.count("n") || !fields.count("target")) return error("n and target are required");
+  absl::StatusOr<Problem> problem = Problem::from_spec(series, fields["n"], fields["target"]);
+  if (!problem.ok()) return error(problem.status().ToString());
+  if (fields.count("kind") && !parse_kind(fields["kind"], &problem->kind))
+    return error("kind must be RESISTANCE, CAPACITANCE or CONDUCTANCE");
+  bool b = true;
+  unsigned int m = std::min(4u, problem->size());
+  double time_limit = default_time_limit;
+  if (fields.count("b") && !absl::SimpleAtob(fields["b"], &b)) return error("b must be a boolean");
+  if (fields.count("m") && (!absl::SimpleAtoi(fields["m"], &m) || m > MAX_SERVE_M))
+    return error("m must be at most " + std::to_string(MAX_SERVE_M));
+  if (fields.count("time_limit") && (!absl::SimpleAtod(fields["time_limit"], &time_limit) || time_limit < 0))
+    return error("time_limit must be a non-negative number of seconds");
+  Params params(b, m);
+  params.time_limit = time_limit;
+  params.cancel = cancel;
+  if (fields.count("tolerance") && !parse_ratio(fields["tolerance"], &params.tolerance))
+    return error("tolerance must be a non-negative ratio");
+  if (solver != "OPT" && solver != "LOCAL") return error("unknown solver: " + solver);
+  if (solver == "LOCAL" && (!m || time_limit <= 0)) return error("LOCAL requires m and a time_limit");
+  CachedSolution solution;
+  if (solutions && solutions->lookup(*problem, solver, params, &solution)) {
+    std::unique_ptr<Node> network(Node::parse(solution.network));
+    network->ratio = solution.cost;
+    print_json_fields(os, *problem, network.get());
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    os << ",\"timed_out\":" << (solution.optimal ? "false" : "true") << ",\"cached\":true,\"seconds\":"
+       << elapsed.count() << "}";
+    return os.str();
+  }
+  std::shared_ptr<const Tabulator> table;
+  if (m) table = cache.get(series, *problem, m);
+  Node* network = NULL;
+  bool timed_out = false;
+  std::unique_ptr<Solver> opt;
+  std::unique_ptr<LocalSolver> local;
+  if (solver == "OPT") {
+    opt = std::make_unique<Solver>(params, table.get());
+    network = opt->solve(*problem);
+    timed_out = opt->timed_out();
+  } else {
+    local = std::make_unique<LocalSolver>(params, table.get(), 2022, nullptr);
+    network = local->solve(*problem);
+    timed_out = true;
+  }
+  if (!network) return error("no solution within the time limit");
+  // A search cut short by its client did not use its time limit.
+  if (solutions && !(cancel && *cancel)) {
+    absl::Status status = solutions->insert(*problem, solver, params, network, !timed_out && !params.tolerance);
+    if (!status.ok()) return error(status.ToString());
+  }
+  print_json_fields(os, *problem, network);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  os << ",\"timed_out\":" << (timed_out ? "true" : "false");
+  if (opt && opt->get_lower_bound() < network->ratio)
+    os << ",\"lower_bound\":" << boost::rational_cast<double>(opt->get_lower_bound());
+  os << ",\"seconds\":" << elapsed.count() << "}";
+  return os.str();
+}
+
+void Server::serve(std::istream& is, std::ostream& os) {
+  std::mutex output_mutex;
+  std::condition_variable done_cv;
+  unsigned int pending = 0;
+  std::string line;
+  while (std::getline(is, line)) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+    {
+      std::lock_guard<std::mutex> lock(output_mutex);
+      ++pending;
+    }
+    submit([&, line]() {
+      std::string reply = answer(line);
+      std::lock_guard<std::mutex> lock(output_mutex);
+      os << reply << std::endl;
+      if (--pending == 0) done_cv.notify_all();
+    });
+  }
+  std::unique_lock<std::mutex> lock(output_mutex);
+  done_cv.wait(lock, [&]() { return pending == 0; });
+}
+
+// A client connection, which is closed once the last reply has been sent.
+struct Connection {
+  int fd; std::mutex mutex; std::atomic<bool> closed;
+  Connection(int _fd) : fd(_fd), closed(false) {}
+  ~Connection() { close(fd); }
+  void write(const std::string& reply) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string line = reply + "\n";
+    for (size_t sent = 0; sent < line.size(); ) {
+      ssize_t n = send(fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+      if (n <= 0) { closed = true; return; }
+      sent += n;
+    }
+  }
+};
+
+absl::Status Server::serve(const std::string& socket_path) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path))
+    return absl::InvalidArgumentError("socket path is too long: " + socket_path);
+  strcpy(address.sun_path, socket_path.c_str());
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) return absl::ErrnoToStatus(errno, "socket");
+  unlink(socket_path.c_str());
+  if (bind(listener, (sockaddr*) &address, sizeof(address)) < 0 || listen(listener, 64) < 0) {
+    close(listener);
+    return absl::ErrnoToStatus(errno, socket_path);
+  }
+  while (true) {
+    int fd = accept(listener, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR) continue;
+      close(listener);
+      return absl::ErrnoToStatus(errno, "accept");
+    }
+    std::thread([this, connection = std::make_shared<Connection>(fd)]() {
+      std::string buffer;
+      char chunk[4096];
+      ssize_t n;
+      while ((n = recv(connection->fd, chunk, sizeof(chunk), 0)) > 0) {
+        buffer.append(chunk, n);
+        for (size_t end; (end = buffer.find('\n')) != std::string::npos; buffer.erase(0, end + 1)) {
+          std::string line = buffer.substr(0, end);
+          if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+          submit([this, connection, line]() { connection->write(answer(line, &connection->closed)); });
+        }
+      }
+      // A client that only shut down its side of the connection still
+      // waits for its replies, but one that hung up does not.
+      pollfd hangup = {connection->fd, 0, 0};
+      if (n < 0 || (poll(&hangup, 1, 0) > 0 && (hangup.revents & POLLHUP))) connection->closed = true;
+    }).detach();
+  }
+}
+
+}
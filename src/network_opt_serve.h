@@ -0,0 +1,80 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _NETWORK_OPT_SERVE_H_
+#define _NETWORK_OPT_SERVE_H_
+
+#include "network_opt_cache.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+namespace network_opt {
+
+// Parses a flat JSON object such as {"series":"E12","n":8,"target":"SQRT"}
+// into its raw field values (strings are unescaped; other values are kept
+// verbatim).  Nested objects and arrays are not supported.
+bool parse_json_object(const std::string& json, std::map<std::string, std::string>& fields);
+
+// Keeps the most recently used tables in memory, keyed by (series, n, m).
+struct TableCache {
+  TableCache(unsigned int _capacity) : capacity(_capacity), clock(0) {}
+  // Tables stay alive for as long as a caller holds on to them, even if
+  // they are evicted in the meantime.
+  std::shared_ptr<const Tabulator> get(const std::string& series, const Problem& problem, unsigned int m);
+
+ private:
+  struct Entry { std::once_flag once; Tabulator tabulator; unsigned long long used; Entry(unsigned int m) : tabulator(m) {} };
+  unsigned int capacity; unsigned long long clock;
+  std::map<std::tuple<std::string, unsigned int, unsigned int>, std::shared_ptr<Entry>> entries;
+  std::mutex mutex;
+};
+
+// Answers newline-delimited JSON queries of the form
+//   {"id":1, "series":"E12", "n":8, "target":"SQRT", "solver":"OPT",
+//    "b":1, "m":4, "time_limit":2.5, "tolerance":"1/1000"}
+// with one JSON line each.  An optional "kind" (see Problem) does not change
+// which table a query uses.  Queries are answered concurrently by a pool of
+// worker threads, so replies may arrive out of order and should be matched
+// by their "id".  OPT queries that stop early return their best network so
+// far, marked as "timed_out" if they ran out of time, along with a proven
+// "lower_bound" on the cost.  The searches of a socket client that hangs
+// up are cancelled.  Queries that solutions (if not NULL) answers are
+// marked as "cached" and skip the search, and the networks of the others
+// are added to it.
+struct Server {
+  Server(unsigned int tables, unsigned int threads, double default_time_limit,
+         SolutionCache* solutions = NULL);
+  ~Server();
+  // Setting *cancel (if not NULL) stops the search early, as a time limit would.
+  std::string answer(const std::string& query, const std::atomic<bool>* cancel = NULL);
+  // Serves the queries read from is until it is exhausted.
+  void serve(std::istream& is, std::ostream& os);
+  // Serves connections on a Unix domain socket until an error occurs.
+  absl::Status serve(const std::string& socket_path);
+
+ private:
+  TableCache cache; double default_time_limit; SolutionCache* solutions;
+  std::deque<std::function<void()>> jobs; std::vector<std::thread> workers; bool stopping;
+  std::mutex mutex; std::condition_variable cv;
+  void submit(const std::function<void()>& job);
+};
+
+}
+
+#endif
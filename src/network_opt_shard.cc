@@ -0,0 +1,101 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "network_opt_shard.h"
+#include "absl/strings/numbers.h"
+#include "network_opt_serve.h"
+#include <algorithm>
+
+namespace network_opt {
+
+bool parse_shard(const std::string& s, unsigned int* shard, unsigned int* shards) {
+  size_t slash = s.find('/');
+  if (slash == std::string::npos) return false;
+  return absl::SimpleAtoi(s.substr(0, slash), shard) && absl::SimpleAtoi(s.substr(slash + 1), shards) &&
+         *shard < *shards;
+}
+
+// Whether network uses every element of the problem exactly once, or for
+// an inventory, any of them at most once and at most max_parts in all.
+static bool uses_each_element_once(const Problem& problem, const Node* network) {
+  std::vector<unsigned int> uses(problem.size());
+  std::vector<const Node*> stack(1, network);
+  while (!stack.empty()) {
+    const Node* node = stack.back(); stack.pop_back();
+    for (auto value : node->values) {
+      if (value >= uses.size() || uses[value]++) return false;
+    }
+    for (auto child : node->children) stack.push_back(child);
+  }
+  unsigned int parts = problem.size() - std::count(uses.begin(), uses.end(), 0);
+  if (problem.inventory) return parts && (!problem.max_parts || parts <= problem.max_parts);
+  return parts == problem.size();
+}
+
+void print_shard_result(std::ostream& os, const Problem& problem, const Params& params,
+                        const Solver& solver, Node* network) {
+  os << "{\"shard\":\"" << params.shard << "/" << params.shards << "\","
+     << "\"timed_out\":" << (solver.timed_out() ? "true" : "false") << ","
+     << "\"lower_bound\":";
+  // An empty shard without a cost cap has no lower bound.
+  if (solver.get_lower_bound() < 0) os << "null,";
+  else os << "\"" << solver.get_lower_bound() << "\",";
+  if (network) print_json_fields(os, problem, network);
+  else os << "\"network\":null";
+  os << "}" << std::endl;
+}
+
+absl::Status merge_shard_results(const Problem& problem, const std::vector<std::string>& lines,
+                                 ShardMerge* merge) {
+  NetworkEvaluator evaluator;
+  std::vector<bool> seen;
+  Ratio best_cost;
+  bool bounded = false;
+  for (auto& line : lines) {
+    std::map<std::string, std::string> fields;
+    unsigned int shard, shards;
+    Ratio lower_bound = -1;
+    if (!parse_json_object(line, fields) || !parse_shard(fields["shard"], &shard, &shards) ||
+        (fields["lower_bound"] != "null" && !parse_ratio(fields["lower_bound"], &lower_bound)))
+      return absl::InvalidArgumentError("invalid shard result: " + line);
+    if (seen.empty()) seen.resize(shards);
+    if (shards != seen.size()) return absl::InvalidArgumentError("results of different shard counts: " + line);
+    if (seen[shard]) return absl::InvalidArgumentError("duplicate result of shard " + fields["shard"]);
+    seen[shard] = true;
+    if (fields["timed_out"] == "true") merge->complete = false;
+    if (!(lower_bound < 0) && (!bounded || lower_bound < merge->lower_bound)) {
+      merge->lower_bound = lower_bound;
+      bounded = true;
+    }
+    if (fields["network"] == "null") continue;
+    Node* network = Node::parse(fields["network"]);
+    if (!network || !uses_each_element_once(problem, network)) {
+      if (network) delete network;
+      return absl::InvalidArgumentError("invalid network in shard " + fields["shard"]);
+    }
+    Ratio cost = evaluator.evaluate_cost(problem, network);
+    if (!merge->network || cost < best_cost) {
+      if (merge->network) delete merge->network;
+      merge->network = network;
+      best_cost = cost;
+    } else {
+      delete network;
+    }
+  }
+  for (unsigned int shard = 0; shard < seen.size(); ++shard)
+    if (!seen[shard]) return absl::InvalidArgumentError("missing result of shard " + std::to_string(shard));
+  if (seen.empty()) return absl::InvalidArgumentError("no shard results");
+  return absl::OkStatus();
+}
+
+}
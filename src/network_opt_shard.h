@@ -0,0 +1,48 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _NETWORK_OPT_SHARD_H_
+#define _NETWORK_OPT_SHARD_H_
+
+#include "network_opt.h"
+
+namespace network_opt {
+
+// Parses a shard specification "i/N" with i < N.
+bool parse_shard(const std::string& s, unsigned int* shard, unsigned int* shards);
+
+// Writes the outcome of a Solver run for shard params.shard of params.shards
+// as one JSON line, e.g.
+//   {"shard":"2/8","timed_out":false,"lower_bound":"1/1000","network":"N()[...]", ...}
+// where network is null if the shard found none within params.max_cost.
+void print_shard_result(std::ostream& os, const Problem& problem, const Params& params,
+                        const Solver& solver, Node* network);
+
+// The combination of the results of every shard of one search.
+struct ShardMerge {
+  ShardMerge() : network(NULL), complete(true) {}
+  ~ShardMerge() { if (network) delete network; }
+  Node* network;  // The best network of any shard (NULL if none found one).
+  Ratio lower_bound;  // The smallest lower bound of any shard.
+  bool complete;  // Whether every shard ran to completion, so network is optimal.
+};
+
+// Merges the result lines of shards 0 to N - 1 (in any order), re-evaluating
+// each network against the problem.  Fails unless every shard of the same N
+// is present exactly once.
+absl::Status merge_shard_results(const Problem& problem, const std::vector<std::string>& lines,
+                                 ShardMerge* merge);
+
+}
+
+#endif
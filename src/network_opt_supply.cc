@@ -0,0 +1,119 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "network_opt_supply.h"
+
+namespace network_opt {
+
+static bool total_less(const Ratio& t1, double r1, const Ratio& t2, double r2) {
+  return (r1 != r2) ? r1 < r2 : t1 < t2;
+}
+
+SupplyTable::SupplyTable(const std::vector<Ratio>& values, unsigned int k) {
+  for (unsigned int c = 1; c <= k; ++c) {
+    std::vector<Entry> entries;
+    if (c == 1) {
+      for (unsigned int v = 0; v < values.size(); ++v) entries.push_back({values[v], boost::rational_cast<double>(values[v]), 0, 0, v, 0});
+    }
+    for (unsigned int i = 1; i <= c / 2; ++i) {
+      const std::vector<Entry>& lefts = levels[i - 1];
+      const std::vector<Entry>& rights = levels[c - i - 1];
+      for (unsigned int a = 0; a < lefts.size(); ++a) {
+        // Both orders of two networks of equal size give the same totals.
+        for (unsigned int b = (i == c - i) ? a : 0; b < rights.size(); ++b) {
+          const Ratio& x = lefts[a].total;
+          const Ratio& y = rights[b].total;
+          Ratio sum = x + y;
+          entries.push_back({sum, boost::rational_cast<double>(sum), '+', i, a, b});
+          Ratio product = x * y / sum;
+          entries.push_back({product, boost::rational_cast<double>(product), '|', i, a, b});
+        }
+      }
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const Entry& e1, const Entry& e2) {
+                       return total_less(e1.total, e1.rounded, e2.total, e2.rounded);
+                     });
+    auto end = std::unique(entries.begin(), entries.end(),
+                           [](const Entry& e1, const Entry& e2) {
+                             return e1.rounded == e2.rounded && e1.total == e2.total;
+                           });
+    // A total that fewer parts reach is kept with those, which loses no
+    // total: any network that uses the larger witness is matched, with
+    // fewer parts, by one that uses the smaller.
+    end = std::remove_if(entries.begin(), end, [&](const Entry& e) {
+      for (unsigned int p = 1; p < c; ++p) if (contains(p, e)) return true;
+      return false;
+    });
+    entries.erase(end, entries.end());
+    entries.shrink_to_fit();
+    levels.push_back(std::move(entries));
+  }
+}
+
+unsigned long long SupplyTable::size() const {
+  unsigned long long size = 0;
+  for (auto& level : levels) size += level.size();
+  return size;
+}
+
+bool SupplyTable::contains(unsigned int parts, const Entry& entry) const {
+  const std::vector<Entry>& level = levels[parts - 1];
+  auto it = std::lower_bound(level.begin(), level.end(), entry, [](const Entry& e1, const Entry& e2) {
+    return total_less(e1.total, e1.rounded, e2.total, e2.rounded);
+  });
+  return it != level.end() && it->rounded == entry.rounded && it->total == entry.total;
+}
+
+// Appends the network of the entry to node, which is a composition by op.
+void SupplyTable::append(unsigned int parts, unsigned int idx, char op, Node* node) const {
+  const Entry& e = levels[parts - 1][idx];
+  if (!e.op) {
+    node->values.push_back(e.left);
+    return;
+  }
+  if (e.op != op) {
+    Node* child = &N();
+    node->children.push_back(child);
+    node = child;
+  }
+  append(e.left_parts, e.left, e.op, node);
+  append(parts - e.left_parts, e.right, e.op, node);
+}
+
+Node* SupplyTable::nearest(const Problem& problem, unsigned int* used_parts) const {
+  unsigned int limit = problem.max_parts ? std::min<unsigned int>(problem.max_parts, parts()) : parts();
+  unsigned int best_parts = 0, best_idx = 0;
+  Ratio best_cost = -1;
+  for (unsigned int c = 1; c <= limit; ++c) {
+    const std::vector<Entry>& level = levels[c - 1];
+    // The cost increases with the total, so the best entry of a level
+    // borders the first whose cost is not negative.
+    auto it = std::partition_point(level.begin(), level.end(),
+                                   [&](const Entry& e) { return problem.get_cost(e.total) < 0; });
+    unsigned int idx = it - level.begin();
+    for (unsigned int i = (idx ? idx - 1 : 0); i <= idx && i < level.size(); ++i) {
+      Ratio cost = problem.get_cost(level[i].total);
+      if (cost < 0) cost = -cost;
+      if (best_cost < 0 || cost < best_cost) { best_cost = cost; best_parts = c; best_idx = i; }
+    }
+  }
+  if (used_parts) *used_parts = best_parts;
+  if (!best_parts) return NULL;
+  Node* network = &N();
+  append(best_parts, best_idx, '+', network);
+  spread_values(network);
+  return network;
+}
+
+}
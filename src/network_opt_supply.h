@@ -0,0 +1,53 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _NETWORK_OPT_SUPPLY_H_
+#define _NETWORK_OPT_SUPPLY_H_
+
+#include "network_opt.h"
+
+namespace network_opt {
+
+// The totals of every network of at most k parts drawn with repetition from
+// the elements of a supply problem, tabulated by part count rather than by
+// subset: the networks of c parts combine those of i and c - i parts (for
+// every i <= c / 2) in series and in parallel.  Each total is kept once, at
+// the fewest parts that reach it, with one witness network, so the tables
+// grow with the number of distinct totals instead of with 2^n.
+struct SupplyTable {
+  SupplyTable(const std::vector<Ratio>& values, unsigned int k);
+
+  unsigned int parts() const { return levels.size(); }
+  // The number of distinct totals of at most k parts.
+  unsigned long long size() const;
+  // Returns the network (owned by the caller) of at most problem.max_parts
+  // parts (or parts() if that is zero or more) whose cost is smallest, with
+  // the fewest parts among equals, and sets *used_parts to its number of parts.
+  // The problem's elements must be the values.
+  Node* nearest(const Problem& problem, unsigned int* used_parts = NULL) const;
+
+ private:
+  // A total first reached with c parts: a single value (c = 1, op = 0), or
+  // the composition by op of entry left of the table of left_parts parts
+  // with entry right of the table of c - left_parts parts.
+  // The total is also rounded, which orders most pairs of entries without
+  // comparing rationals, since rounding preserves order.
+  struct Entry { Ratio total; double rounded; char op; unsigned int left_parts, left, right; };
+  std::vector<std::vector<Entry>> levels;  // levels[c - 1] is sorted by total.
+  bool contains(unsigned int parts, const Entry& entry) const;
+  void append(unsigned int parts, unsigned int idx, char op, Node* node) const;
+};
+
+}
+
+#endif
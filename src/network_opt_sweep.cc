@@ -0,0 +1,122 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "network_opt_sweep.h"
+
+namespace network_opt {
+
+// Adds value as a term of node.
+static void add_term(Node* node, Value value) {
+  node->values.push_back(value);
+  spread_values(node);
+}
+
+// Adds value at the given position, counting the nodes (as a new term of
+// each) and then their values (composed with each in the other way).
+// Returns false if there are fewer positions.
+static bool insert_at(Node* node, Value value, unsigned int& position) {
+  if (!position--) {
+    add_term(node, value);
+    return true;
+  }
+  for (auto it = node->values.begin(); it != node->values.end(); ++it) {
+    if (position--) continue;
+    node->children.push_back(&N({*it, value}));
+    node->values.erase(it);
+    return true;
+  }
+  for (auto child : node->children)
+    if (insert_at(child, value, position)) return true;
+  return false;
+}
+
+Node* insert_element(const Problem& problem, const Node* network, Value value) {
+  NetworkEvaluator evaluator;
+  // In parallel with the whole network, whose root becomes a series term.
+  Node* best = &N();
+  best->children.push_back(&(N(value)[*Node::parse(network->to_network())]));
+  Ratio best_cost = evaluator.evaluate_cost(problem, best);
+  for (unsigned int p = 0; ; ++p) {
+    Node* candidate = Node::parse(network->to_network());
+    unsigned int position = p;
+    if (!insert_at(candidate, value, position)) {
+      delete candidate;
+      break;
+    }
+    Ratio cost = evaluator.evaluate_cost(problem, candidate);
+    if (cost < best_cost) {
+      std::swap(best, candidate);
+      best_cost = cost;
+    }
+    delete candidate;
+  }
+  return best;
+}
+
+SweepSolver::SweepSolver(const Params& _params) : params(_params), tabulator(NULL), table(NULL) {
+  if (params.m) table = tabulator = new Tabulator(params.m);
+}
+
+SweepSolver::SweepSolver(const Params& _params, const Tabulator* shared_tabulator)
+    : params(_params), tabulator(NULL), table(shared_tabulator) {}
+
+SweepSolver::~SweepSolver() {
+  clear();
+  if (tabulator) delete tabulator;
+}
+
+void SweepSolver::clear() {
+  for (auto& point : points) delete point.network;
+  points.clear();
+}
+
+absl::StatusOr<std::vector<SweepPoint>> SweepSolver::solve(const std::vector<Problem>& problems) {
+  clear();
+  for (unsigned int i = 1; i < problems.size(); ++i) {
+    const std::vector<Ratio>& before = problems[i - 1].elements;
+    const std::vector<Ratio>& after = problems[i].elements;
+    if (after.size() < before.size() || !std::equal(before.begin(), before.end(), after.begin()))
+      return absl::InvalidArgumentError("the elements of problem " + std::to_string(i) +
+                                        " do not extend those of the one before");
+  }
+  if (tabulator && !problems.empty()) tabulator->tabulate(problems.back());
+  for (unsigned int i = 0; i < problems.size(); ++i) {
+    const Problem& problem = problems[i];
+    auto start = std::chrono::steady_clock::now();
+    Solver solver(params, table);
+    SweepPoint point;
+    const Node* previous = i ? points.back().network : NULL;
+    if (previous) {
+      Node* seed = Node::parse(previous->to_network());
+      for (Value value = problems[i - 1].size(); value < problem.size(); ++value) {
+        Node* inserted = insert_element(problem, seed, value);
+        delete seed;
+        seed = inserted;
+      }
+      point.seed_cost = NetworkEvaluator().evaluate_cost(problem, seed);
+      solver.seed(seed);
+      delete seed;
+    }
+    Node* network = solver.solve(problem);
+    if (network) {
+      point.network = Node::parse(network->to_network());
+      point.cost = network->ratio;
+    }
+    point.optimal = !solver.timed_out() && !params.tolerance;
+    point.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    points.push_back(point);
+  }
+  return points;
+}
+
+}
@@ -0,0 +1,57 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _NETWORK_OPT_SWEEP_H_
+#define _NETWORK_OPT_SWEEP_H_
+
+#include "network_opt.h"
+
+namespace network_opt {
+
+// Returns a copy of network (owned by the caller) with element value added
+// where it costs least for the problem: as a new series or parallel term of
+// some node, in the other composition with one of its values, or in
+// parallel with the whole network.
+Node* insert_element(const Problem& problem, const Node* network, Value value);
+
+// One point of the curve of the best cost against the number of elements.
+struct SweepPoint {
+  Node* network = NULL;  // Owned by the SweepSolver; NULL if none was found.
+  Ratio cost = -1;
+  Ratio seed_cost = -1;  // Of the warm start, or -1 if there was none.
+  bool optimal = false;
+  double seconds = 0;
+};
+
+// Solves a sequence of problems whose elements each extend those of the one
+// before, such as n = 1..N of a series.  The table is tabulated once, for
+// the last problem, since its masks cover every prefix of its elements, and
+// each search is seeded with the previous optimum with the new elements
+// inserted where they cost least, so that it prunes from the first node.
+struct SweepSolver {
+  SweepSolver(const Params& params);
+  // Searches with a table that the caller has already tabulated for the last problem.
+  SweepSolver(const Params& params, const Tabulator* shared_tabulator);
+  ~SweepSolver();
+  // Returns a point per problem, or an error if the elements of a problem do
+  // not extend those of the one before.
+  absl::StatusOr<std::vector<SweepPoint>> solve(const std::vector<Problem>& problems);
+  const Tabulator* get_table() const { return table; }
+
+ private: Params params; Tabulator* tabulator; const Tabulator* table; std::vector<SweepPoint> points;
+  void clear();
+};
+
+}
+
+#endif
@@ -0,0 +1,155 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "network_opt_tolerance.h"
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <thread>
+
+namespace network_opt {
+
+FlatNetwork::FlatNetwork(const Node* network) {
+  compile(network, '+');
+}
+
+// Appends the instructions that push the total of node (a composition by op).
+void FlatNetwork::compile(const Node* node, char op) {
+  for (auto value : node->values) program.push_back({0, value});
+  for (auto child : node->children) compile(child, child->ratio ? '+' : (op == '+') ? '|' : '+');
+  unsigned int operands = node->values.size() + node->children.size();
+  if (operands > 1) program.push_back({op, operands});
+}
+
+void FlatNetwork::evaluate(const double* elements, double* totals) const {
+  // Every operand on the stack holds at least one element, and a Mask has a bit per element.
+  double stack[8 * sizeof(Mask)][LANES];
+  unsigned int top = 0;
+  for (auto& instruction : program) {
+    if (!instruction.op) {
+      const double* values = elements + instruction.arg * LANES;
+      for (unsigned int l = 0; l < LANES; ++l) stack[top][l] = values[l];
+      ++top;
+      continue;
+    }
+    top -= instruction.arg;
+    double (&result)[LANES] = stack[top];
+    if (instruction.op == '+') {
+      for (unsigned int i = 1; i < instruction.arg; ++i)
+        for (unsigned int l = 0; l < LANES; ++l) result[l] += stack[top + i][l];
+    } else {
+      for (unsigned int l = 0; l < LANES; ++l) result[l] = 1 / result[l];
+      for (unsigned int i = 1; i < instruction.arg; ++i)
+        for (unsigned int l = 0; l < LANES; ++l) result[l] += 1 / stack[top + i][l];
+      for (unsigned int l = 0; l < LANES; ++l) result[l] = 1 / result[l];
+    }
+    ++top;
+  }
+  for (unsigned int l = 0; l < LANES; ++l) totals[l] = stack[0][l];
+}
+
+const unsigned long long CHUNK_SAMPLES = 1 << 16;
+
+// SplitMix64, which is several times faster than std::mt19937_64 and good
+// enough for sampling.
+struct SampleGenerator {
+  using result_type = uint64_t;
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return ~result_type(0); }
+  SampleGenerator(uint64_t seed) : state(seed) {}
+  result_type operator()() {
+    uint64_t x = (state += 0x9e3779b97f4a7c15ull);
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+  // Uniform in [-1, 1).
+  double symmetric() { return double((*this)() >> 11) * 0x1.0p-52 - 1; }
+ private: uint64_t state;
+};
+
+// Sums over the samples of one chunk, which are combined in chunk order.
+struct ChunkSums { double sum = 0, sum_of_squares = 0, min = INFINITY, max = -INFINITY; unsigned long long passed = 0; };
+
+ToleranceAnalysis analyze_tolerance(const Problem& problem, const Node* network, const ToleranceParams& params) {
+  FlatNetwork flat(network);
+  std::vector<double> nominal;
+  for (unsigned int i = 0; i < problem.size(); ++i) nominal.push_back(boost::rational_cast<double>(problem[i]));
+  double target = boost::rational_cast<double>(problem.target);
+  if (problem.square) target = std::sqrt(target);
+  unsigned long long chunks = (params.samples + CHUNK_SAMPLES - 1) / CHUNK_SAMPLES;
+  std::vector<ChunkSums> sums(chunks);
+  std::atomic<unsigned long long> next(0);
+  auto work = [&]() {
+    const unsigned int lanes = FlatNetwork::LANES;
+    std::vector<double> elements(nominal.size() * lanes);
+    double totals[lanes];
+    for (unsigned long long chunk; (chunk = next++) < chunks; ) {
+      SampleGenerator rng(params.seed * 0x9e3779b97f4a7c15ull + chunk);
+      std::normal_distribution<double> normal(0, 1.0 / 3);
+      unsigned long long begin = chunk * CHUNK_SAMPLES;
+      unsigned long long end = std::min(begin + CHUNK_SAMPLES, params.samples);
+      ChunkSums& chunk_sums = sums[chunk];
+      for (unsigned long long sample = begin; sample < end; sample += lanes) {
+        for (unsigned int i = 0; i < nominal.size(); ++i) {
+          for (unsigned int l = 0; l < lanes; ++l) {
+            double deviation = params.normal ? normal(rng) : rng.symmetric();
+            elements[i * lanes + l] = nominal[i] * (1 + params.tolerance * deviation);
+          }
+        }
+        flat.evaluate(elements.data(), totals);
+        if (problem.kind == Problem::CONDUCTANCE)
+          for (unsigned int l = 0; l < lanes; ++l) totals[l] = 1 / totals[l];
+        for (unsigned int l = 0; l < lanes && sample + l < end; ++l) {
+          chunk_sums.sum += totals[l];
+          chunk_sums.sum_of_squares += totals[l] * totals[l];
+          chunk_sums.min = std::min(chunk_sums.min, totals[l]);
+          chunk_sums.max = std::max(chunk_sums.max, totals[l]);
+          if (std::abs(totals[l] - target) <= params.spec * target) ++chunk_sums.passed;
+        }
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  for (unsigned int i = 1; i < params.threads; ++i) workers.emplace_back(work);
+  work();
+  for (auto& worker : workers) worker.join();
+  ChunkSums total;
+  for (auto& chunk_sums : sums) {
+    total.sum += chunk_sums.sum;
+    total.sum_of_squares += chunk_sums.sum_of_squares;
+    total.min = std::min(total.min, chunk_sums.min);
+    total.max = std::max(total.max, chunk_sums.max);
+    total.passed += chunk_sums.passed;
+  }
+  ToleranceAnalysis analysis;
+  if (!params.samples) return analysis;
+  analysis.mean = total.sum / params.samples;
+  analysis.stddev = std::sqrt(std::max(0.0, total.sum_of_squares / params.samples - analysis.mean * analysis.mean));
+  analysis.min = total.min;
+  analysis.max = total.max;
+  analysis.yield = double(total.passed) / params.samples;
+  return analysis;
+}
+
+void print_tolerance(std::ostream& os, const ToleranceAnalysis& analysis, const ToleranceParams& params,
+                     const std::string& prefix) {
+  os << std::setprecision(6);
+  os << prefix << "   Yield: " << 100 * analysis.yield << "% within " << 100 * params.spec << "% of the target ("
+     << params.samples << " samples, " << 100 * params.tolerance << "% " << (params.normal ? "normal" : "uniform")
+     << " parts)" << std::endl;
+  os << prefix << "  Spread: mean " << analysis.mean << ", stddev " << analysis.stddev << ", range ["
+     << analysis.min << ", " << analysis.max << "]" << std::endl;
+}
+
+}
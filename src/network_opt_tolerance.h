@@ -0,0 +1,64 @@
+/*
+Copyright 2022 Google LLC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    https://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _NETWORK_OPT_TOLERANCE_H_
+#define _NETWORK_OPT_TOLERANCE_H_
+
+#include "network_opt.h"
+
+namespace network_opt {
+
+// A network compiled into postfix form, whose total is evaluated in double
+// precision for LANES sets of element values at once.  The lanes are plain
+// loops over fixed-size arrays, which the compiler turns into SIMD code.
+struct FlatNetwork {
+  static constexpr unsigned int LANES = 8;
+  FlatNetwork(const Node* network);
+  // Sets totals[l] to the total of the network in which element i has the
+  // value elements[i * LANES + l], for each lane l.
+  void evaluate(const double* elements, double* totals) const;
+
+ private:
+  struct Instruction { char op; unsigned int arg; };  // An element (op 0), or op applied to arg operands.
+  std::vector<Instruction> program;
+  void compile(const Node* node, char op);
+};
+
+struct ToleranceParams {
+  double tolerance = 0.05;  // Relative tolerance of every element.
+  bool normal = false;  // Elements are normal with sigma = tolerance / 3 if set, and otherwise uniform.
+  double spec = 0.01;  // Samples whose total is within this relative distance of the target pass.
+  unsigned long long samples = 1000000;
+  unsigned int threads = 1;
+  unsigned int seed = 2022;
+};
+
+// The distribution of the total of a network whose elements vary.
+struct ToleranceAnalysis {
+  double mean = 0, stddev = 0, min = 0, max = 0;
+  double yield = 0;  // The fraction of samples that pass.
+};
+
+// Samples the elements of network independently around their values in
+// problem, in chunks of a fixed size that each draw from their own seed, so
+// the result does not depend on the number of threads.  The target of a
+// square problem is the square root of its target, and the totals of a
+// CONDUCTANCE problem are conductances.
+ToleranceAnalysis analyze_tolerance(const Problem& problem, const Node* network, const ToleranceParams& params);
+
+void print_tolerance(std::ostream& os, const ToleranceAnalysis& analysis, const ToleranceParams& params,
+                     const std::string& prefix);
+
+}
+
+#endif
@@ -37,8 +37,6 @@ struct Visualizer {
   void visualize_schematic(std::ostream& os, const Problem& problem, Visual& visual, char op1 = '+', char op2 = '|');
   void visualize_tree(std::ostream& os, Node* node, char op1, char op2);
 };
-    
-extern Visualizer visualizer;
 
 }
 
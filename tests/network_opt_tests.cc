@@ -13,8 +13,23 @@ limitations under the License.
 
 #include "gtest/gtest.h"
 
+#include "../src/network_opt_async.h"
+#include "../src/network_opt_batch.h"
+#include "../src/network_opt_cache.h"
+#include "../src/network_opt_evolve.h"
+#include "../src/network_opt_index.h"
+#include "../src/network_opt_ladder.h"
+#include "../src/network_opt_local.h"
+#include "../src/network_opt_multi.h"
+#include "../src/network_opt_serve.h"
+#include "../src/network_opt_shard.h"
+#include "../src/network_opt_supply.h"
+#include "../src/network_opt_sweep.h"
+#include "../src/network_opt_tolerance.h"
 #include "../src/network_opt_utils.h"
 
+#include <thread>
+
 namespace network_opt {
 namespace {
 
@@ -40,9 +55,78 @@ TEST(NodeTest, AllTests) {
   delete network;
 }
 
+TEST(NodeTest, Parse) {
+  for (std::string s : {"N()[N(0)][N()[N(1)][N(2)][N(3)]][N(4)]", "N()[N({0,2})][N(6)[N(5)[N({1,4})]][N(3)]]",
+                        "N({0,1,2})", "N(10)[N(11)]"}) {
+    Node* network = Node::parse(s);
+    ASSERT_NE(network, nullptr);
+    EXPECT_EQ(network->to_network(), s);
+    delete network;
+  }
+  for (std::string s : {"", "N(", "N()[", "N()[N(1)", "N({1,2)", "N(1)x", "M()"}) EXPECT_EQ(Node::parse(s), nullptr);
+}
+
+TEST(ProblemTest, FromSpec) {
+  absl::StatusOr<Problem> problem = Problem::from_spec("E12", "4", "SQRT");
+  ASSERT_TRUE(problem.ok());
+  EXPECT_EQ(problem->size(), 4);
+  EXPECT_EQ(problem->target, Ratio(4));
+  EXPECT_TRUE(problem->square);
+  problem = Problem::from_spec("INT", "12", "PI");
+  ASSERT_TRUE(problem.ok());
+  EXPECT_EQ(problem->target, RATIO_PI);
+  EXPECT_FALSE(problem->square);
+  EXPECT_FALSE(Problem::from_spec("E24", "4", "SQRT").ok());
+  EXPECT_FALSE(Problem::from_spec("E12", "13", "SQRT").ok());
+  EXPECT_FALSE(Problem::from_spec("E12", "0", "SQRT").ok());
+  EXPECT_FALSE(Problem::from_spec("E12", "four", "SQRT").ok());
+  EXPECT_FALSE(Problem::from_spec("E12", "4", "TAU").ok());
+  problem = Problem::from_spec("INT", "3", "0.9");
+  ASSERT_TRUE(problem.ok());
+  EXPECT_EQ(problem->target, Ratio(9, 10));
+}
+
+TEST(ProblemTest, ParseRatio) {
+  Ratio ratio;
+  ASSERT_TRUE(parse_ratio("0.9", &ratio));
+  EXPECT_EQ(ratio, Ratio(9, 10));
+  ASSERT_TRUE(parse_ratio("0.08", &ratio));
+  EXPECT_EQ(ratio, Ratio(2, 25));
+  // Leading zeros are decimal, not octal.
+  ASSERT_TRUE(parse_ratio("010", &ratio));
+  EXPECT_EQ(ratio, Ratio(10));
+  ASSERT_TRUE(parse_ratio("09/012", &ratio));
+  EXPECT_EQ(ratio, Ratio(3, 4));
+  ASSERT_TRUE(parse_ratio("0", &ratio));
+  EXPECT_EQ(ratio, Ratio(0));
+  EXPECT_FALSE(parse_ratio("1/00", &ratio));
+  EXPECT_FALSE(parse_ratio("-1", &ratio));
+}
+
+TEST(ProblemTest, Kinds) {
+  Problem problem(INT_SERIES, 3, Ratio(3, 2), false);
+  Node* network = &N()[NT(1)][N()[NT(2)][NT(3)]];
+  EXPECT_EQ(network->to_string(problem), "1+(2|3)");
+  EXPECT_EQ(problem.get_cost(Ratio(11, 5)), Ratio(7, 10));
+  problem.kind = Problem::CAPACITANCE;
+  EXPECT_EQ(network->to_string(problem), "1|(2+3)");
+  EXPECT_EQ(problem.get_cost(Ratio(11, 5)), Ratio(7, 10));
+  problem.kind = Problem::CONDUCTANCE;
+  EXPECT_EQ(network->to_string(problem), "1+(2|3)");
+  EXPECT_EQ(problem.measure(Ratio(11, 5)), Ratio(5, 11));
+  EXPECT_EQ(problem.get_cost(Ratio(11, 5)), Ratio(23, 22));
+  EXPECT_LT(problem.get_cost(Ratio(1, 2)), problem.get_cost(Ratio(2)));
+  Problem::Kind kind;
+  EXPECT_TRUE(parse_kind("CAPACITANCE", &kind));
+  EXPECT_EQ(kind, Problem::CAPACITANCE);
+  EXPECT_FALSE(parse_kind("INDUCTANCE", &kind));
+  delete network;
+}
+
 TEST(NetworkEvaluatorTest, AllTests) {
   Problem problem5(INT_SERIES, 5, Ratio(5), true);
   Problem problem8(INT_SERIES, 8, Ratio(8), true);
+  NetworkEvaluator network_evaluator;
   Node* network = NULL;
 
   network = &N()[NT(1)][NT(2)][NT(3)][NT(4)][NT(5)];
@@ -63,6 +147,41 @@ TEST(NetworkEvaluatorTest, AllTests) {
   delete network;
 }
 
+TEST(NetworkEvaluatorTest, Holes) {
+  // Holes at several depths of a network with loose values, filled with
+  // every pair of entries for their elements.
+  Problem problem(INT_SERIES, 8, Ratio(8), true);
+  Tabulator tabulator(2);
+  tabulator.tabulate(problem);
+  const auto& entries_x = tabulator.lookup_table[(1 << 4) | (1 << 5)];
+  const auto& entries_y = tabulator.lookup_table[(1 << 6) | (1 << 7)];
+  NetworkEvaluator evaluator;
+  for (const char* spec : {"N()[N(0)][N({1,2,3})]", "N()[N({0,1})[N(2)][N(3)]]", "N(0)[N(1)[N({2,3})]]"}) {
+    Node* network = Node::parse(spec);
+    Node* expandable_x = network->children.front();
+    Node* expandable_y = network->children.back()->children.empty() ? network->children.back()
+                                                                     : network->children.back()->children.back();
+    for (const auto& x : entries_x) {
+      expandable_x->children.push_back(x.second);
+      HoleFunction single = evaluator.evaluate_holes(problem, network, x.second, NULL);
+      for (const auto& y : entries_y) {
+        expandable_y->children.push_back(y.second);
+        Ratio total = evaluator.evaluate_total(problem, network);
+        EXPECT_EQ(evaluator.evaluate_holes(problem, network, x.second, y.second)(x.first, y.first), total);
+        EXPECT_EQ(evaluator.evaluate_holes(problem, network, entries_x[0].second, y.second)(x.first, y.first),
+                  total);
+        expandable_y->children.pop_back();
+      }
+      expandable_x->children.pop_back();
+      expandable_x->children.push_back(entries_x[0].second);
+      Ratio total = evaluator.evaluate_total(problem, network);
+      expandable_x->children.pop_back();
+      EXPECT_EQ(single(entries_x[0].first, 0), total);
+    }
+    delete network;
+  }
+}
+
 TEST(ExpanderTest, AllTests) {
   Node* network = NULL;
 
@@ -132,6 +251,120 @@ TEST(TabulatorTest, AllTests) {
   delete network;
 }
 
+TEST(TabulatorTest, MultiSearch) {
+  Problem problem(INT_SERIES, 10, Ratio(10), true);
+  Tabulator tabulator(3);
+  tabulator.tabulate(problem);
+  Node* network = &N()[NT({1,2,3})][N()[NT({4,5,6})][N(9)[NT({7,8,10})]]];
+  Expander expander(network);
+  std::vector<Node*> expandables;
+  std::vector<Values> values;
+  for (Node* node; (node = expander.expandable()); ) {
+    expandables.push_back(node);
+    values.push_back(node->values);
+    node->values.clear();
+  }
+  ASSERT_EQ(expandables.size(), 3);
+  // Tries every combination of entries.
+  NetworkEvaluator evaluator;
+  SubsetCoder coder;
+  Ratio best = -1;
+  for (auto& x : tabulator.lookup_table[coder.encode(values[0])]) {
+    for (auto& y : tabulator.lookup_table[coder.encode(values[1])]) {
+      for (auto& z : tabulator.lookup_table[coder.encode(values[2])]) {
+        expandables[0]->children.push_back(x.second);
+        expandables[1]->children.push_back(y.second);
+        expandables[2]->children.push_back(z.second);
+        Ratio cost = evaluator.evaluate_cost(problem, network);
+        if (best < 0 || cost < best) best = cost;
+        for (auto expandable : expandables) expandable->children.pop_back();
+      }
+    }
+  }
+  Stats stats;
+  std::vector<Node*> nodes = tabulator.multi_search(problem, network, expandables, values, -1, &stats);
+  ASSERT_EQ(nodes.size(), 3);
+  for (unsigned int i = 0; i < 3; ++i) expandables[i]->children.push_back(nodes[i]);
+  EXPECT_EQ(evaluator.evaluate_cost(problem, network), best);
+  for (auto expandable : expandables) expandable->children.pop_back();
+  if (Stats::enabled) {
+    EXPECT_LT(stats.evaluations, 8 * 8 * 8 / 4);
+  }
+  EXPECT_TRUE(tabulator.multi_search(problem, network, expandables, values, best).empty());
+  for (unsigned int i = 0; i < 3; ++i) expandables[i]->values = values[i];
+  delete network;
+}
+
+TEST(TabulatorTest, SaveLoad) {
+  Problem problem(E12_SERIES, 6, Ratio(6), true);
+  std::string path = testing::TempDir() + "/network_opt_table";
+  Tabulator tabulator(3);
+  tabulator.tabulate(problem);
+  ASSERT_TRUE(tabulator.save(problem, path).ok());
+  // Any target and kind over the same elements can use the saved table.
+  Problem capacitance(E12_SERIES, 6, Ratio(5, 2), false);
+  capacitance.kind = Problem::CAPACITANCE;
+  Tabulator loaded(3);
+  ASSERT_TRUE(loaded.load(capacitance, path).ok());
+  ASSERT_EQ(loaded.lookup_table.size(), tabulator.lookup_table.size());
+  for (Mask mask = 0; mask < tabulator.lookup_table.size(); ++mask) {
+    ASSERT_EQ(loaded.lookup_table[mask].size(), tabulator.lookup_table[mask].size());
+    for (unsigned int i = 0; i < tabulator.lookup_table[mask].size(); ++i) {
+      EXPECT_EQ(loaded.lookup_table[mask][i].first, tabulator.lookup_table[mask][i].first);
+      EXPECT_EQ(loaded.lookup_table[mask][i].second->ratio, tabulator.lookup_table[mask][i].first);
+      EXPECT_EQ(loaded.lookup_table[mask][i].second->to_network(), tabulator.lookup_table[mask][i].second->to_network());
+    }
+  }
+  Solver solver(Params(true, 3));
+  Solver shared(Params(true, 3), &loaded);
+  EXPECT_EQ(shared.solve(capacitance)->ratio, solver.solve(capacitance)->ratio);
+  EXPECT_FALSE(Tabulator(2).load(problem, path).ok());
+  EXPECT_FALSE(Tabulator(3).load(Problem(E12_SERIES, 5, Ratio(5), true), path).ok());
+  EXPECT_FALSE(Tabulator(3).load(problem, path + ".missing").ok());
+}
+
+TEST(TabulatorTest, Enumerate) {
+  Problem problem(INT_SERIES, 7, Ratio(7), true);
+  const unsigned long long networks[] = {1, 1, 2, 8, 52, 472, 5504, 78416};
+  for (unsigned int k = 0; k <= 7; ++k) {
+    unsigned long long count = 0;
+    EXPECT_TRUE(enumerate_networks(problem, (1 << k) - 1, [&](const Node*, const Ratio&) { return ++count; }));
+    EXPECT_EQ(count, (k == 0) ? 0 : networks[k]);
+  }
+  Tabulator tabulator(3);
+  tabulator.tabulate(problem);
+  Mask mask = SubsetCoder().encode({1, 4, 5});
+  std::vector<Ratio> totals;
+  enumerate_networks(problem, mask, [&](const Node* network, const Ratio& total) {
+    EXPECT_EQ(NetworkEvaluator().evaluate_total(problem, network), total);
+    totals.push_back(total);
+    return true;
+  });
+  std::sort(totals.begin(), totals.end());
+  ASSERT_EQ(totals.size(), tabulator.lookup_table[mask].size());
+  for (unsigned int i = 0; i < totals.size(); ++i) EXPECT_EQ(totals[i], tabulator.lookup_table[mask][i].first);
+  unsigned int count = 0;
+  EXPECT_FALSE(enumerate_networks(problem, mask, [&](const Node*, const Ratio&) { return ++count < 3; }));
+  EXPECT_EQ(count, 3);
+}
+
+TEST(TabulatorTest, Estimate) {
+  Problem problem(INT_SERIES, 9, Ratio(9), true);
+  for (unsigned int m = 1; m <= 4; ++m) {
+    Tabulator tabulator(m);
+    tabulator.tabulate(problem);
+    unsigned long long entries = 0;
+    for (auto& entry : tabulator.lookup_table) entries += entry.size();
+    TableEstimate estimate = estimate_table(problem.size(), m);
+    EXPECT_EQ(estimate.entries, entries);
+    EXPECT_NEAR(estimate.bytes, tabulator.bytes(), 0.1 * tabulator.bytes());
+    EXPECT_EQ(choose_m(problem.size(), estimate.bytes), m);
+    EXPECT_EQ(choose_m(problem.size(), estimate.bytes - 1), m - 1);
+  }
+  EXPECT_EQ(choose_m(4, 1e12), 4);
+  EXPECT_EQ(choose_m(4, 1e12, 1e-9), 0);
+}
+
 void check_network(Node* network, Ratio ratio) {
   EXPECT_EQ(network->ratio, ratio);
 }
@@ -159,5 +392,731 @@ TEST(SolverTest, True3Params) {
   test_solver(true, 3);
 }
 
+TEST(SolverTest, SharedTabulator) {
+  // The table for the first seven integers also covers every prefix of them.
+  Tabulator tabulator(3);
+  tabulator.tabulate(Problem(INT_SERIES, 7, Ratio(7), true));
+  Solver solver(Params(true, 3), &tabulator);
+  check_network(solver.solve(Problem(INT_SERIES, 5, Ratio(5), true)), Ratio(5, 81));
+  check_network(solver.solve(Problem(INT_SERIES, 7, Ratio(7), true)), Ratio(1, 2304));
+}
+
+TEST(SolverTest, Conductance) {
+  // The resistor networks of the first six integers closest to a conductance of 3/7.
+  Problem problem(INT_SERIES, 6, Ratio(3, 7), false);
+  problem.kind = Problem::CONDUCTANCE;
+  Ratio best = -1;
+  enumerate_networks(problem, (1 << problem.size()) - 1, [&](const Node*, const Ratio& total) {
+    Ratio cost = 1 / total - problem.target;
+    if (cost < 0) cost = -cost;
+    if (best < 0 || cost < best) best = cost;
+    return true;
+  });
+  Solver solver(Params(true, 3));
+  Node* network = solver.solve(problem);
+  EXPECT_EQ(network->ratio, best);
+  EXPECT_EQ(NetworkEvaluator().evaluate_cost(problem, network), best);
+}
+
+TEST(SolverTest, Inventory) {
+  Problem problem(INT_SERIES, 6, Ratio(11, 7), false);
+  problem.inventory = true;
+  EXPECT_EQ(inventory_subsets(problem).size(), 63);
+  // The best network of each subset, solved on its own.
+  Ratio best = -1;
+  for (Mask mask : inventory_subsets(problem)) {
+    Problem subset(INT_SERIES, 0, problem.target, false);
+    for (unsigned int i = 0; i < problem.size(); ++i) if (mask >> i & 1) subset.elements.push_back(problem[i]);
+    Ratio cost = Solver(Params(true, 0)).solve(subset)->ratio;
+    if (best < 0 || cost < best) best = cost;
+  }
+  for (unsigned int m : {0, 3}) {
+    Solver solver(Params(true, m));
+    Node* network = solver.solve(problem);
+    EXPECT_EQ(network->ratio, best);
+    EXPECT_EQ(NetworkEvaluator().evaluate_cost(problem, network), best);
+    MultiSolver multi_solver(Params(true, m));
+    EXPECT_EQ(multi_solver.solve({problem})[0]->ratio, best);
+  }
+  problem.max_parts = 2;
+  EXPECT_EQ(inventory_subsets(problem).size(), 21);
+  Solver limited(Params(true, 3));
+  EXPECT_LE(__builtin_popcount(used_elements(limited.solve(problem))), 2);
+  // Subsets that only swap equal parts are searched once.
+  Problem ones(ONE_SERIES, 6, Ratio(3, 2), false);
+  ones.inventory = true;
+  EXPECT_EQ(inventory_subsets(ones).size(), 6);
+  Solver solver(Params(true, 2));
+  Node* network = solver.solve(ones);
+  EXPECT_EQ(network->ratio, Ratio(0));
+  EXPECT_EQ(__builtin_popcount(used_elements(network)), 3);
+}
+
+TEST(SolverTest, TimeLimit) {
+  Params params(true, 0);
+  params.time_limit = 0.05;
+  Solver solver(params);
+  Node* network = solver.solve(Problem(INT_SERIES, 12, RATIO_PI, false));
+  EXPECT_TRUE(solver.timed_out());
+  ASSERT_NE(network, nullptr);
+  EXPECT_LT(solver.get_lower_bound(), network->ratio);
+}
+
+TEST(SolverTest, Tolerance) {
+  Problem problem(INT_SERIES, 7, Ratio(7), true);
+  Params params(true, 2);
+  params.tolerance = Ratio(1, 10);
+  Solver solver(params);
+  Node* network = solver.solve(problem);
+  ASSERT_NE(network, nullptr);
+  EXPECT_FALSE(solver.timed_out());
+  EXPECT_LE(network->ratio, params.tolerance);
+  EXPECT_LE(solver.get_lower_bound(), Ratio(1, 2304));
+}
+
+TEST(SolverTest, Trace) {
+  std::ostringstream os;
+  Solver solver(Params(true, 2));
+  solver.set_trace(&os);
+  check_network(solver.solve(Problem(INT_SERIES, 6, Ratio(6), true)), Ratio(278, 178929));
+  EXPECT_EQ(solver.get_lower_bound(), Ratio(278, 178929));
+  std::istringstream lines(os.str());
+  std::string line, last;
+  double previous = -1;
+  while (std::getline(lines, line)) {
+    std::map<std::string, std::string> fields;
+    ASSERT_TRUE(parse_json_object(line, fields));
+    double cost = atof(fields["cost"].c_str());
+    if (previous >= 0) {
+      EXPECT_LT(cost, previous);
+    }
+    previous = cost;
+    last = line;
+  }
+  EXPECT_NE(last.find("\"exact_cost\":\"278/178929\""), std::string::npos);
+}
+
+TEST(SolverTest, Checkpoint) {
+  Problem problem(INT_SERIES, 7, Ratio(7), true);
+  std::string path = testing::TempDir() + "/network_opt_checkpoint";
+  Solver complete(Params(true, 2));
+  Ratio optimum = complete.solve(problem)->ratio;
+  Params params(true, 2);
+  params.time_limit = 0.05;
+  Solver interrupted(params);
+  interrupted.set_checkpoint(path, 0.01);
+  interrupted.solve(problem);
+  ASSERT_TRUE(interrupted.timed_out());
+  EXPECT_TRUE(interrupted.get_checkpoint_status().ok());
+  Solver resumed(Params(true, 2));
+  EXPECT_FALSE(resumed.resume(Problem(INT_SERIES, 6, Ratio(6), true), path).ok());
+  ASSERT_TRUE(resumed.resume(problem, path).ok());
+  EXPECT_EQ(resumed.solve(problem)->ratio, optimum);
+  EXPECT_FALSE(resumed.timed_out());
+  if (Stats::enabled) {
+    EXPECT_LT(resumed.get_stats().nodes, complete.get_stats().nodes);
+  }
+}
+
+TEST(SolverTest, Shards) {
+  Problem problem(INT_SERIES, 7, Ratio(7), true);
+  Solver complete(Params(true, 2));
+  Ratio optimum = complete.solve(problem)->ratio;
+  std::vector<std::string> lines;
+  for (unsigned int shard = 0; shard < 3; ++shard) {
+    Params params(true, 2);
+    params.shard = shard;
+    params.shards = 3;
+    Solver solver(params);
+    Node* network = solver.solve(problem);
+    ASSERT_NE(network, nullptr);
+    EXPECT_GE(network->ratio, optimum);
+    std::ostringstream os;
+    print_shard_result(os, problem, params, solver, network);
+    lines.push_back(os.str());
+  }
+  ShardMerge merge;
+  ASSERT_TRUE(merge_shard_results(problem, lines, &merge).ok());
+  EXPECT_TRUE(merge.complete);
+  EXPECT_EQ(NetworkEvaluator().evaluate_cost(problem, merge.network), optimum);
+  EXPECT_EQ(merge.lower_bound, optimum);
+  ShardMerge incomplete;
+  EXPECT_FALSE(merge_shard_results(problem, {lines[0], lines[2]}, &incomplete).ok());
+  ShardMerge duplicate;
+  EXPECT_FALSE(merge_shard_results(problem, {lines[0], lines[1], lines[1]}, &duplicate).ok());
+
+  // A cost cap below the optimum leaves nothing to find, and proves as much.
+  Params params(true, 2);
+  params.max_cost = optimum / 2;
+  Solver capped(params);
+  EXPECT_EQ(capped.solve(problem), nullptr);
+  EXPECT_EQ(capped.get_lower_bound(), params.max_cost);
+  params.max_cost = optimum;
+  Solver exact(params);
+  ASSERT_NE(exact.solve(problem), nullptr);
+  EXPECT_EQ(exact.solve(problem)->ratio, optimum);
+}
+
+TEST(SolverTest, Seed) {
+  Problem problem(INT_SERIES, 6, Ratio(6), true);
+  Node* seed = &N()[NT(1)][NT(2)][NT(3)][NT(4)][NT(5)][NT(6)];
+  Solver solver(Params(true, 0));
+  solver.seed(seed);
+  delete seed;
+  check_network(solver.solve(problem), Ratio(278, 178929));
+  // An optimal seed is returned as is.
+  seed = Node::parse(solver.solve(problem)->to_network());
+  solver.seed(seed);
+  delete seed;
+  check_network(solver.solve(problem), Ratio(278, 178929));
+}
+
+TEST(SolverTest, TopK) {
+  Problem problem(INT_SERIES, 6, Ratio(6), true);
+  std::vector<std::vector<Ratio>> costs;
+  for (unsigned int t : {0, 2, 3}) {
+    for (bool b : {false, true}) {
+      Params params(b, t);
+      params.k = 5;
+      Solver solver(params);
+      check_network(solver.solve(problem), Ratio(278, 178929));
+      ASSERT_EQ(solver.solutions().size(), 5);
+      std::set<std::string> canonicals;
+      costs.emplace_back();
+      for (Node* network : solver.solutions()) {
+        EXPECT_EQ(NetworkEvaluator().evaluate_cost(problem, network), network->ratio);
+        canonicals.insert(canonical_network(problem, network));
+        costs.back().push_back(network->ratio);
+      }
+      EXPECT_EQ(canonicals.size(), 5);
+      EXPECT_TRUE(std::is_sorted(costs.back().begin(), costs.back().end()));
+      EXPECT_EQ(costs.back(), costs.front());
+    }
+  }
+  // Equal elements make table entries of equal totals that complete the
+  // same network, which must not crowd the others out of the window.
+  Problem ones(ONE_SERIES, 4, Ratio(9, 10), false);
+  std::vector<Ratio> one_costs;
+  for (unsigned int t : {1, 4}) {
+    Params params(true, t);
+    params.k = 4;
+    Solver solver(params);
+    solver.solve(ones);
+    ASSERT_EQ(solver.solutions().size(), 4);
+    std::vector<Ratio> found;
+    for (Node* network : solver.solutions()) found.push_back(network->ratio);
+    if (one_costs.empty()) one_costs = found;
+    EXPECT_EQ(found, one_costs);
+  }
+  EXPECT_EQ(one_costs[2], Ratio(3, 20));
+  Node* network_0 = &N()[NT(1)][N()[NT(2)][NT(3)]];
+  Node* network_1 = &N()[N()[NT(3)][NT(2)]][NT(1)];
+  Node* network_2 = &N()[NT(3)][N()[NT(1)][NT(2)]];
+  EXPECT_EQ(canonical_network(problem, network_0), canonical_network(problem, network_1));
+  EXPECT_NE(canonical_network(problem, network_0), canonical_network(problem, network_2));
+  delete network_0; delete network_1; delete network_2;
+}
+
+TEST(SolverTest, Transpositions) {
+  Problem problem(INT_SERIES, 7, Ratio(7), true);
+  std::vector<uint64_t> hashes = element_hashes(problem);
+  // Parallel networks (a root with a single child) have several terms.
+  Node* network_0 = &N()[N()[N()[NT(1)][NT(2)]][N()[NT(3)][NT(4)]]];
+  Node* network_1 = &N()[N()[N()[NT(4)][NT(3)]][N()[NT(2)][NT(1)]]];
+  Node* network_2 = &N()[N()[N()[NT(1)][NT(2)]][N()[NT(3)][NT(5)]]];
+  EXPECT_EQ(canonical_network(problem, network_0), canonical_network(problem, network_1));
+  EXPECT_NE(canonical_network(problem, network_0), canonical_network(problem, network_2));
+  EXPECT_EQ(canonical_hash(hashes, network_0), canonical_hash(hashes, network_1));
+  EXPECT_NE(canonical_hash(hashes, network_0), canonical_hash(hashes, network_2));
+  delete network_0; delete network_1; delete network_2;
+  // Values still to be expanded are not terms of their node.
+  Node* partial_0 = &N({0, 1, 2})[NT(4)];
+  Node* partial_1 = &N()[NT(1)][NT(2)][NT(3)][NT(4)];
+  EXPECT_NE(canonical_hash(hashes, partial_0), canonical_hash(hashes, partial_1));
+  delete partial_0; delete partial_1;
+
+  // The partitions are enumerated without repetition, so only the networks
+  // completed from tables recur; skipping them leaves the result unchanged.
+  for (unsigned int t : {0, 3}) {
+    Solver plain(Params(true, t));
+    Params params(true, t);
+    params.transposition_bits = 16;
+    Solver solver(params);
+    EXPECT_EQ(solver.solve(problem)->ratio, plain.solve(problem)->ratio);
+    if (!Stats::enabled) continue;
+    const Stats& stats = solver.get_stats();
+    if (t == 0) {
+      EXPECT_EQ(stats.transpositions, 0);
+    }
+    else EXPECT_GT(stats.transpositions, 0);
+    EXPECT_EQ(stats.nodes + stats.transpositions, plain.get_stats().nodes);
+  }
+}
+
+TEST(SolverTest, Stats) {
+  Problem problem(INT_SERIES, 7, Ratio(7), true);
+  Solver solver(Params(true, 3));
+  solver.solve(problem);
+  const Stats& stats = solver.get_stats();
+  if (!Stats::enabled) {
+    EXPECT_EQ(stats.nodes, 0);
+    return;
+  }
+  EXPECT_GT(stats.nodes, 0);
+  EXPECT_GT(stats.prunes, 0);
+  EXPECT_LE(stats.prunes, stats.bounds);
+  EXPECT_GT(stats.leaves, 0);
+  EXPECT_GT(stats.binary_searches + stats.linear_searches, 0);
+  EXPECT_GE(stats.probes, stats.binary_searches + stats.linear_searches);
+  EXPECT_GT(stats.entries, 0);
+  EXPECT_EQ(stats.evaluations, stats.entries + stats.probes + stats.leaves + 2 * stats.bounds);
+  // A search without a Bounder or a table visits every partial network.
+  Solver exhaustive(Params(false, 0));
+  exhaustive.solve(problem);
+  EXPECT_GT(exhaustive.get_stats().nodes, stats.nodes);
+  EXPECT_EQ(exhaustive.get_stats().bounds, 0);
+  EXPECT_EQ(exhaustive.get_stats().entries, 0);
+  Params params(true, 3);
+  params.time_limit = 0.05;
+  LocalSolver local_solver(params, 2022, nullptr);
+  local_solver.solve(problem);
+  EXPECT_GT(local_solver.get_stats().restarts, 0);
+  EXPECT_EQ(local_solver.get_stats().leaves, local_solver.get_stats().restarts);
+}
+
+TEST(SolverTest, ConcurrentSolvers) {
+  std::vector<std::thread> threads;
+  for (unsigned int t = 0; t < 4; ++t) threads.emplace_back(test_solver, true, t % 2 ? 3 : 0);
+  for (auto& thread : threads) thread.join();
+}
+
+TEST(LadderTest, AllTests) {
+  // 11/5 = 1 + 1/(1/2 + 1/3) is the ladder 1+(2|3).
+  Problem problem(INT_SERIES, 3, Ratio(11, 5), false);
+  for (LadderOrder order : {LadderOrder::INCREASING, LadderOrder::GREEDY}) {
+    Node* ladder = build_ladder(problem, order);
+    EXPECT_EQ(NetworkEvaluator().evaluate_cost(problem, ladder), Ratio(0));
+    delete ladder;
+  }
+  Node* ladder = build_ladder(problem, LadderOrder::DECREASING);
+  EXPECT_EQ(ladder->to_string(problem), "(2+1)|3");
+  delete ladder;
+  for (Problem::Kind kind : {Problem::RESISTANCE, Problem::CONDUCTANCE}) {
+    Problem sqrt7(INT_SERIES, 7, Ratio(7), true);
+    sqrt7.kind = kind;
+    Node* best = best_ladder(sqrt7);
+    EXPECT_EQ(used_elements(best), (1u << 7) - 1);
+    Ratio best_cost = NetworkEvaluator().evaluate_cost(sqrt7, best);
+    for (LadderOrder order : {LadderOrder::DECREASING, LadderOrder::INCREASING, LadderOrder::GREEDY}) {
+      ladder = build_ladder(sqrt7, order);
+      EXPECT_EQ(used_elements(ladder), (1u << 7) - 1);
+      EXPECT_LE(best_cost, NetworkEvaluator().evaluate_cost(sqrt7, ladder));
+      delete ladder;
+    }
+    // A ladder seeds the exact search without changing its result.
+    Solver solver(Params(true, 3));
+    Ratio optimum = solver.solve(sqrt7)->ratio;
+    solver.seed(best);
+    EXPECT_EQ(solver.solve(sqrt7)->ratio, optimum);
+    delete best;
+  }
+}
+
+TEST(AsyncSolveTest, AllTests) {
+  // OPT runs to completion and reports each new best, ending with the optimum.
+  std::vector<Incumbent> called;
+  AsyncSolve opt(Problem(INT_SERIES, 6, Ratio(6), true), Params(true, 2), SolveMethod::OPT, NULL,
+                 [&](const Incumbent& incumbent) { called.push_back(incumbent); });
+  SolveResult result = opt.result().get();
+  ASSERT_NE(result.network, nullptr);
+  EXPECT_EQ(result.cost, Ratio(278, 178929));
+  EXPECT_TRUE(result.optimal);
+  EXPECT_FALSE(result.cancelled);
+  std::vector<Incumbent> polled = opt.poll();
+  ASSERT_FALSE(polled.empty());
+  EXPECT_EQ(polled.size(), called.size());
+  for (unsigned int i = 1; i < polled.size(); ++i) EXPECT_LT(polled[i].cost, polled[i - 1].cost);
+  EXPECT_EQ(polled.back().network, result.network->to_network());
+  EXPECT_TRUE(opt.poll().empty());
+  // LOCAL with no time limit stops only once cancelled.
+  Problem problem(E12_SERIES, 9, RATIO_PI, false);
+  AsyncSolve local(problem, Params(true, 3), SolveMethod::LOCAL);
+  Incumbent best;
+  while (!local.best(&best)) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  EXPECT_FALSE(local.done());
+  local.cancel();
+  result = local.result().get();
+  EXPECT_TRUE(result.cancelled);
+  EXPECT_FALSE(result.optimal);
+  ASSERT_NE(result.network, nullptr);
+  EXPECT_LE(result.cost, best.cost);
+  EXPECT_EQ(NetworkEvaluator().evaluate_cost(problem, result.network.get()), result.cost);
+  // A cancelled OPT still proves a lower bound, and destroying a running
+  // solve cancels it.
+  AsyncSolve exact(Problem(INT_SERIES, 12, RATIO_PI, false), Params(true, 0));
+  while (!exact.best(&best)) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  exact.cancel();
+  result = exact.result().get();
+  EXPECT_TRUE(result.cancelled);
+  EXPECT_FALSE(result.optimal);
+  EXPECT_LT(result.lower_bound, result.cost);
+  AsyncSolve abandoned(problem, Params(true, 3), SolveMethod::EVOLVE);
+}
+
+TEST(SweepSolverTest, AllTests) {
+  // Any network can take one more element, and the best place for it is no
+  // worse than in parallel with the whole network.
+  Problem problem(INT_SERIES, 3, Ratio(3), true);
+  Node* network = &N()[NT(1)][NT(2)];
+  Node* inserted = insert_element(problem, network, 2);
+  EXPECT_EQ(NetworkEvaluator().evaluate_cost(problem, inserted), Ratio(3, 4));
+  delete inserted;
+  delete network;
+  // The same curve as test_solver(), from one table.
+  std::vector<Problem> problems;
+  for (unsigned int n = 2; n <= 7; ++n) problems.push_back(Problem(INT_SERIES, n, Ratio(n), true));
+  for (unsigned int m : {0, 3}) {
+    SweepSolver solver(Params(true, m));
+    absl::StatusOr<std::vector<SweepPoint>> points = solver.solve(problems);
+    ASSERT_TRUE(points.ok());
+    ASSERT_EQ(points->size(), 6);
+    std::vector<Ratio> costs = {Ratio(14, 9), Ratio(3, 4), Ratio(0), Ratio(5, 81), Ratio(278, 178929),
+                                Ratio(1, 2304)};
+    for (unsigned int i = 0; i < costs.size(); ++i) {
+      const SweepPoint& point = (*points)[i];
+      EXPECT_EQ(point.cost, costs[i]);
+      EXPECT_EQ(NetworkEvaluator().evaluate_cost(problems[i], point.network), costs[i]);
+      EXPECT_TRUE(point.optimal);
+      if (i) EXPECT_GE(point.seed_cost, point.cost); else EXPECT_LT(point.seed_cost, 0);
+    }
+  }
+  problems.push_back(Problem(E12_SERIES, 8, Ratio(8), true));
+  EXPECT_FALSE(SweepSolver(Params(true, 0)).solve(problems).ok());
+}
+
+TEST(MultiSolverTest, AllTests) {
+  std::vector<Problem> problems;
+  for (auto target : {Ratio(6), Ratio(8), Ratio(5, 2), Ratio(2), Ratio(22, 7)})
+    problems.push_back(Problem(INT_SERIES, 6, target, target == Ratio(6) || target == Ratio(8)));
+  problems[3].kind = Problem::CONDUCTANCE;
+  problems[4].kind = Problem::CAPACITANCE;
+  for (unsigned int m : {0, 3}) {
+    for (unsigned int k : {1, 3}) {
+      Params params(true, m);
+      params.k = k;
+      MultiSolver multi_solver(params);
+      std::vector<Node*> networks = multi_solver.solve(problems);
+      ASSERT_EQ(networks.size(), problems.size());
+      for (unsigned int i = 0; i < problems.size(); ++i) {
+        Solver solver(params);
+        solver.solve(problems[i]);
+        ASSERT_EQ(multi_solver.solutions(i).size(), solver.solutions().size());
+        for (unsigned int j = 0; j < solver.solutions().size(); ++j)
+          EXPECT_EQ(multi_solver.solutions(i)[j]->ratio, solver.solutions()[j]->ratio);
+        EXPECT_EQ(NetworkEvaluator().evaluate_cost(problems[i], networks[i]), networks[i]->ratio);
+      }
+    }
+  }
+  Params params(true, 3);
+  params.max_cost = Ratio(1, 1000);
+  MultiSolver bounded(params);
+  std::vector<Node*> networks = bounded.solve(problems);
+  for (unsigned int i = 0; i < problems.size(); ++i) {
+    Solver solver(params);
+    Node* network = solver.solve(problems[i]);
+    EXPECT_EQ(networks[i] ? networks[i]->ratio : Ratio(-1), network ? network->ratio : Ratio(-1));
+  }
+}
+
+TEST(EvolutionSolverTest, AllTests) {
+  Problem problem(E12_SERIES, 9, RATIO_PI, false);
+  EvolutionParams evolution;
+  evolution.population = 16;
+  evolution.generations = 10;
+  std::string networks[2];
+  for (unsigned int threads : {1, 3}) {
+    evolution.threads = threads;
+    EvolutionSolver solver(Params(true, 3), evolution);
+    Node* network = solver.solve(problem);
+    EXPECT_EQ(solver.get_generations(), 10);
+    EXPECT_EQ(NetworkEvaluator().evaluate_cost(problem, network), network->ratio);
+    // Every element is used exactly once.
+    std::vector<unsigned int> uses(problem.size());
+    std::function<void(const Node*)> count = [&](const Node* node) {
+      for (auto value : node->values) ++uses[value];
+      for (auto child : node->children) count(child);
+    };
+    count(network);
+    EXPECT_EQ(uses, std::vector<unsigned int>(problem.size(), 1));
+    networks[threads > 1] = network->to_network();
+  }
+  EXPECT_EQ(networks[0], networks[1]);
+  // With no generation limit, it stops once it reaches the tolerance.
+  Params params(true, 2);
+  params.tolerance = Ratio(1, 100);
+  params.time_limit = 60;
+  EvolutionSolver solver(params);
+  EXPECT_LE(solver.solve(Problem(INT_SERIES, 6, Ratio(6), true))->ratio, Ratio(1, 100));
+}
+
+TEST(ToleranceTest, AllTests) {
+  Problem problem(INT_SERIES, 7, Ratio(7), true);
+  Node* network = &N()[N()[N()[NT(3)][NT(7)]][N()[NT(1)][NT(2)][NT(6)]][N()[NT(4)][NT(5)]]];
+  double total = boost::rational_cast<double>(NetworkEvaluator().evaluate_total(problem, network));
+  FlatNetwork flat(network);
+  double elements[7 * FlatNetwork::LANES], totals[FlatNetwork::LANES];
+  for (unsigned int i = 0; i < 7; ++i)
+    for (unsigned int l = 0; l < FlatNetwork::LANES; ++l) elements[i * FlatNetwork::LANES + l] = (i + 1) * (l + 1);
+  flat.evaluate(elements, totals);
+  // Scaling every element scales the total.
+  for (unsigned int l = 0; l < FlatNetwork::LANES; ++l) EXPECT_NEAR(totals[l], total * (l + 1), 1e-12 * (l + 1));
+
+  ToleranceParams params;
+  params.tolerance = 0;
+  params.samples = 1000;
+  ToleranceAnalysis exact = analyze_tolerance(problem, network, params);
+  EXPECT_NEAR(exact.mean, total, 1e-12);
+  EXPECT_EQ(exact.min, exact.max);
+  EXPECT_EQ(exact.yield, std::abs(total - std::sqrt(7.0)) <= 0.01 * std::sqrt(7.0));
+
+  params.tolerance = 0.05;
+  params.samples = 200000;
+  params.spec = 0.5;
+  ToleranceAnalysis loose = analyze_tolerance(problem, network, params);
+  EXPECT_NEAR(loose.mean, total, 0.01 * total);
+  EXPECT_GT(loose.stddev, 0);
+  EXPECT_LE(loose.max - loose.min, 0.1 * total * 1.01);
+  EXPECT_EQ(loose.yield, 1);
+  params.spec = 0.01;
+  params.threads = 3;
+  ToleranceAnalysis tight = analyze_tolerance(problem, network, params);
+  EXPECT_LT(tight.yield, 1);
+  params.threads = 1;
+  ToleranceAnalysis serial = analyze_tolerance(problem, network, params);
+  EXPECT_EQ(serial.mean, tight.mean);
+  EXPECT_EQ(serial.yield, tight.yield);
+  params.normal = true;
+  EXPECT_LT(analyze_tolerance(problem, network, params).stddev, tight.stddev);
+  delete network;
+}
+
+TEST(ResistanceIndexTest, AllTests) {
+  Problem problem(INT_SERIES, 6, Ratio(6), true);
+  std::string path = testing::TempDir() + "/network_opt_index";
+  ASSERT_TRUE(ResistanceIndex::build(problem, 2, 0, path).ok());
+  absl::StatusOr<std::unique_ptr<ResistanceIndex>> index = ResistanceIndex::open(path);
+  ASSERT_TRUE(index.ok());
+  EXPECT_TRUE((*index)->complete());
+  unsigned long long size = (*index)->size();
+  for (const Ratio& target : {Ratio(6), Ratio(7), Ratio(1, 3), Ratio(100)}) {
+    Problem targeted(INT_SERIES, 6, target, true);
+    Solver solver(Params(true, 2));
+    Ratio optimum = solver.solve(targeted)->ratio;
+    absl::StatusOr<Node*> network = (*index)->nearest(targeted);
+    ASSERT_TRUE(network.ok());
+    EXPECT_EQ(NetworkEvaluator().evaluate_cost(targeted, *network), optimum);
+    delete *network;
+  }
+  EXPECT_FALSE((*index)->nearest(Problem(INT_SERIES, 5, Ratio(5), true)).ok());
+  // A partial index still yields an upper bound that seeds the solver.
+  ASSERT_TRUE(ResistanceIndex::build(problem, 2, 8, path).ok());
+  index = ResistanceIndex::open(path);
+  ASSERT_TRUE(index.ok());
+  EXPECT_FALSE((*index)->complete());
+  EXPECT_LT((*index)->size(), size);
+  absl::StatusOr<Node*> network = (*index)->nearest(problem);
+  ASSERT_TRUE(network.ok());
+  Solver solver(Params(true, 2));
+  solver.seed(*network);
+  delete *network;
+  check_network(solver.solve(problem), Ratio(278, 178929));
+}
+
+TEST(SupplyTableTest, AllTests) {
+  // One part gives 1, two give 2 and 1/2, and three give 3, 1/3, 3/2 and 2/3.
+  absl::StatusOr<Problem> ones = Problem::from_supply_spec("ONE", "3", "SQRT");
+  ASSERT_TRUE(ones.ok());
+  EXPECT_EQ(ones->size(), 1);
+  EXPECT_EQ(ones->max_parts, 3);
+  SupplyTable one_table(ones->elements, 3);
+  EXPECT_EQ(one_table.size(), 7);
+  unsigned int parts = 0;
+  Node* network = one_table.nearest(*ones, &parts);
+  EXPECT_EQ(NetworkEvaluator().evaluate_total(*ones, network), Ratio(3, 2));
+  EXPECT_EQ(parts, 3);
+  delete network;
+  EXPECT_FALSE(Problem::from_supply_spec("E12", "0", "SQRT").ok());
+  // At most 4 parts drawn from 1, 2 and 3 match the best network over an
+  // inventory of four of each.
+  Problem supply(INT_SERIES, 3, Ratio(0), false);
+  supply.max_parts = 4;
+  SupplyTable table(supply.elements, 4);
+  Problem inventory(INT_SERIES, 0, Ratio(0), false);
+  for (unsigned int i = 0; i < 4; ++i) for (unsigned int v = 0; v < 3; ++v) inventory.elements.push_back(supply[v]);
+  inventory.inventory = true;
+  inventory.max_parts = 4;
+  for (const Ratio& target : {Ratio(7, 5), Ratio(11, 7), Ratio(13), Ratio(1, 9), Ratio(3)}) {
+    for (Problem::Kind kind : {Problem::RESISTANCE, Problem::CONDUCTANCE}) {
+      supply.target = inventory.target = target;
+      supply.kind = inventory.kind = kind;
+      Solver solver(Params(true, 0));
+      Ratio optimum = solver.solve(inventory)->ratio;
+      network = table.nearest(supply, &parts);
+      EXPECT_EQ(NetworkEvaluator().evaluate_cost(supply, network), optimum);
+      // Networks that repeat values print and parse like any other.
+      Node* copy = Node::parse(network->to_network());
+      ASSERT_NE(copy, nullptr);
+      EXPECT_EQ(NetworkEvaluator().evaluate_total(supply, copy), NetworkEvaluator().evaluate_total(supply, network));
+      delete copy;
+      unsigned int values = 0;
+      std::function<void(const Node*)> count = [&](const Node* node) {
+        values += node->values.size();
+        for (auto child : node->children) count(child);
+      };
+      count(network);
+      EXPECT_EQ(values, parts);
+      delete network;
+    }
+  }
+  supply.target = Ratio(13);
+  supply.kind = Problem::RESISTANCE;
+  supply.max_parts = 2;
+  network = table.nearest(supply, &parts);
+  EXPECT_EQ(NetworkEvaluator().evaluate_total(supply, network), Ratio(6));
+  EXPECT_EQ(parts, 2);
+  delete network;
+}
+
+TEST(SolutionCacheTest, AllTests) {
+  std::string path = testing::TempDir() + "/network_opt_cache";
+  std::remove(path.c_str());
+  Problem problem(INT_SERIES, 6, Ratio(6), true);
+  Params params(true, 2);
+  params.time_limit = 5;
+  Solver solver(params);
+  Node* optimum = solver.solve(problem);
+  {
+    absl::StatusOr<std::unique_ptr<SolutionCache>> cache = SolutionCache::open(path);
+    ASSERT_TRUE(cache.ok());
+    CachedSolution solution;
+    EXPECT_FALSE((*cache)->lookup(problem, "OPT", params, &solution));
+    // A network that is not proven optimal only answers the same search
+    // with at most its time limit.
+    Node* ladder = best_ladder(problem);
+    ASSERT_TRUE((*cache)->insert(problem, "LOCAL", params, ladder, false).ok());
+    EXPECT_TRUE((*cache)->lookup(problem, "LOCAL", params, &solution));
+    EXPECT_FALSE(solution.optimal);
+    EXPECT_EQ(solution.network, ladder->to_network());
+    EXPECT_EQ(solution.budget, 5);
+    Params longer = params;
+    longer.time_limit = 10;
+    EXPECT_FALSE((*cache)->lookup(problem, "LOCAL", longer, &solution));
+    EXPECT_FALSE((*cache)->lookup(problem, "LOCAL", Params(true, 3), &solution));
+    EXPECT_FALSE((*cache)->lookup(problem, "OPT", params, &solution));
+    delete ladder;
+    // A proven optimum answers every search of the problem.
+    ASSERT_TRUE((*cache)->insert(problem, "OPT", params, optimum, true).ok());
+    ASSERT_TRUE((*cache)->lookup(problem, "LOCAL", longer, &solution));
+    EXPECT_TRUE(solution.optimal);
+    EXPECT_EQ(solution.cost, Ratio(278, 178929));
+    EXPECT_FALSE((*cache)->lookup(Problem(INT_SERIES, 6, Ratio(6), false), "OPT", params, &solution));
+    // Except searches that keep no network costing more than it.
+    Params bounded = params;
+    bounded.max_cost = Ratio(1, 1000);
+    EXPECT_FALSE((*cache)->lookup(problem, "OPT", bounded, &solution));
+    bounded.max_cost = Ratio(1, 100);
+    EXPECT_TRUE((*cache)->lookup(problem, "OPT", bounded, &solution));
+    EXPECT_EQ((*cache)->size(), 2);
+  }
+  // The file holds the same solutions.
+  absl::StatusOr<std::unique_ptr<SolutionCache>> reopened = SolutionCache::open(path);
+  ASSERT_TRUE(reopened.ok());
+  EXPECT_EQ((*reopened)->size(), 2);
+  CachedSolution solution;
+  ASSERT_TRUE((*reopened)->lookup(problem, "OPT", Params(false, 0), &solution));
+  EXPECT_EQ(solution.network, optimum->to_network());
+  EXPECT_FALSE(SolutionCache::open(testing::TempDir()).ok());
+  // The server answers repeated queries from the cache.
+  Server server(1, 1, 10, reopened->get());
+  std::string query = "{\"id\":1,\"series\":\"INT\",\"n\":5,\"target\":\"SQRT\",\"m\":3}";
+  std::string reply = server.answer(query);
+  EXPECT_EQ(reply.find("\"cached\""), std::string::npos);
+  reply = server.answer(query);
+  EXPECT_NE(reply.find("\"cached\":true"), std::string::npos);
+  EXPECT_NE(reply.find("\"exact_total\":\"20/9\""), std::string::npos);
+  std::remove(path.c_str());
+}
+
+TEST(BatchSolverTest, AllTests) {
+  std::istringstream is("INT 5 SQRT\n\nINT 7 SQRT\nE12 13 SQRT\nINT 4 4\n");
+  std::ostringstream os;
+  BatchSolver batch_solver(Params(true, 3), 2);
+  EXPECT_EQ(batch_solver.solve(is, os), 4);
+  std::map<int, std::string> lines;
+  std::istringstream results(os.str());
+  for (std::string line; std::getline(results, line); ) lines[atoi(line.c_str() + 8)] = line;
+  ASSERT_EQ(lines.size(), 4);
+  EXPECT_NE(lines[1].find("\"exact_total\":\"20/9\""), std::string::npos);
+  EXPECT_NE(lines[3].find("\"exact_total\":\"127/48\""), std::string::npos);
+  EXPECT_NE(lines[4].find("\"error\":"), std::string::npos);
+  EXPECT_NE(lines[5].find("\"cost\":0,"), std::string::npos);
+  std::istringstream single_pass_is("INT 7 SQRT\nINT 7 3\nINT 5 SQRT\nINT 7 7/3\n");
+  std::ostringstream single_pass_os;
+  BatchSolver single_pass_solver(Params(true, 3), 2, true);
+  EXPECT_EQ(single_pass_solver.solve(single_pass_is, single_pass_os), 4);
+  lines.clear();
+  std::istringstream single_pass_results(single_pass_os.str());
+  for (std::string line; std::getline(single_pass_results, line); ) lines[atoi(line.c_str() + 8)] = line;
+  ASSERT_EQ(lines.size(), 4);
+  EXPECT_NE(lines[1].find("\"exact_total\":\"127/48\""), std::string::npos);
+  EXPECT_NE(lines[2].find("\"cost\":0,"), std::string::npos);
+  EXPECT_NE(lines[3].find("\"exact_total\":\"20/9\""), std::string::npos);
+  EXPECT_NE(lines[4].find("\"cost\":0,"), std::string::npos);
+  // Targets with no network within max_cost are reported as such.
+  Params capped(true, 3);
+  capped.max_cost = Ratio(1, 100000000);
+  for (bool single_pass : {false, true}) {
+    std::istringstream capped_is("INT 5 SQRT\nINT 5 2\n");
+    std::ostringstream capped_os;
+    BatchSolver capped_solver(capped, 1, single_pass);
+    EXPECT_EQ(capped_solver.solve(capped_is, capped_os), 2);
+    EXPECT_NE(capped_os.str().find("\"spec\":\"INT 5 SQRT\",\"network\":null"), std::string::npos);
+    EXPECT_NE(capped_os.str().find("\"cost\":0,"), std::string::npos);
+  }
+}
+
+TEST(ServerTest, ParseJsonObject) {
+  std::map<std::string, std::string> fields;
+  EXPECT_TRUE(parse_json_object(" {\"id\": 7, \"series\" : \"E\\\"12\", \"b\":true} ", fields));
+  EXPECT_EQ(fields["id"], "7");
+  EXPECT_EQ(fields["series"], "E\"12");
+  EXPECT_EQ(fields["b"], "true");
+  EXPECT_FALSE(parse_json_object("{\"id\":7", fields));
+  EXPECT_FALSE(parse_json_object("{\"id\":[7]}", fields));
+  EXPECT_FALSE(parse_json_object("\"id\":7", fields));
+}
+
+TEST(ServerTest, Answer) {
+  Server server(1, 1, 10);
+  std::string reply = server.answer("{\"id\":\"x\",\"series\":\"INT\",\"n\":5,\"target\":\"SQRT\",\"m\":3}");
+  EXPECT_EQ(reply.find("{\"id\":\"x\","), 0);
+  EXPECT_NE(reply.find("\"exact_total\":\"20/9\""), std::string::npos);
+  EXPECT_NE(reply.find("\"timed_out\":false"), std::string::npos);
+  // Evicts the first table, and answers from a table for a different n.
+  reply = server.answer("{\"id\":2,\"series\":\"INT\",\"n\":4,\"target\":\"SQRT\",\"m\":3}");
+  EXPECT_NE(reply.find("\"cost\":0,"), std::string::npos);
+  reply = server.answer("{\"id\":3,\"series\":\"INT\",\"n\":4,\"target\":\"SQRT\",\"m\":9}");
+  EXPECT_NE(reply.find("\"error\":"), std::string::npos);
+  reply = server.answer("{\"id\":4,\"series\":\"INT\",\"n\":4,\"target\":\"1/2\",\"m\":3,\"kind\":\"CONDUCTANCE\"}");
+  EXPECT_NE(reply.find("\"exact_total\":\"1/2\""), std::string::npos);
+  reply = server.answer("{\"id\":5,\"series\":\"INT\",\"n\":4,\"target\":\"2\",\"kind\":\"INDUCTANCE\"}");
+  EXPECT_NE(reply.find("\"error\":"), std::string::npos);
+  std::istringstream is("{\"id\":1,\"series\":\"INT\",\"n\":4,\"target\":\"SQRT\"}\n{\"id\":2}\n");
+  std::ostringstream os;
+  server.serve(is, os);
+  std::string replies = os.str();
+  EXPECT_EQ(std::count(replies.begin(), replies.end(), '\n'), 2);
+}
+
 }  // namespace
 }  // namespace network_opt